@@ -0,0 +1,47 @@
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "EarleyParser.hpp"
+#include "Grammar.hpp"
+
+using namespace cfg;
+
+// Measures Earley recognizer throughput (items per second) for growing inputs,
+// built by repeating a snippet, and reports it next to the resulting column sizes.
+//
+// usage: earley_bench [grammar file] [snippet] [max input length]
+
+int main(int argc, char **argv) {
+
+    const std::string grammar = argc > 1 ? argv[1] : "examples/Expr.grammar";
+    const std::string snippet = argc > 2 ? argv[2] : "x := f(a, b) + 1; ";
+    const std::size_t max_length = argc > 3 ? std::stoul(argv[3]) : 4096;
+
+    EarleyParser parser;
+
+    try {
+        parser.initGrammar(grammar);
+    } catch (std::runtime_error &e) {
+        std::cout << "Grammar Parse Error: " << e.what() << '\n';
+        return 1;
+    }
+
+    std::cout << std::setw(10) << "length" << std::setw(12) << "items" << std::setw(12) << "avg column"
+              << std::setw(12) << "max column" << std::setw(12) << "time [ms]" << std::setw(16) << "items/sec" << '\n';
+
+    for (std::string input = snippet; input.length() <= max_length; input += input) {
+        ParseStatistics statistics;
+        const bool success = parser.parseTree(toTerminals(input), &statistics).first;
+
+        const double seconds = std::chrono::duration<double>(statistics.recognizeTime).count();
+
+        std::cout << std::setw(10) << input.length() << std::setw(12) << statistics.items
+                  << std::setw(12) << statistics.items / statistics.columns << std::setw(12) << statistics.maxColumnSize
+                  << std::setw(12) << std::fixed << std::setprecision(2) << seconds * 1e3
+                  << std::setw(16) << std::setprecision(0) << statistics.items / seconds
+                  << (success ? "" : "  (rejected)") << '\n';
+    }
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "EarleyParser.hpp"
+#include "Grammar.hpp"
+#include "ParseForest.hpp"
+
+using namespace cfg;
+
+// Measures building a parse forest, counting its derivations and taking its first
+// tree for growing inputs, built by repeating a snippet. The default grammar nests
+// one level deeper per input symbol, so the largest inputs show that none of the
+// three runs out of stack on trees 100000 levels deep.
+//
+// usage: forest_bench [grammar file] [snippet] [max input length]
+
+int main(int argc, char **argv) {
+
+    const std::string grammar = argc > 1 ? argv[1] : "examples/RightRecursion.grammar";
+    const std::string snippet = argc > 2 ? argv[2] : "a";
+    const std::size_t max_length = argc > 3 ? std::stoul(argv[3]) : 131072;
+
+    EarleyParser parser;
+
+    try {
+        parser.initGrammar(grammar);
+    } catch (std::runtime_error &e) {
+        std::cout << "Grammar Parse Error: " << e.what() << '\n';
+        return 1;
+    }
+
+    std::cout << std::setw(10) << "length" << std::setw(12) << "nodes" << std::setw(14) << "derivations"
+              << std::setw(12) << "forest [ms]" << std::setw(12) << "count [ms]" << std::setw(12) << "tree [ms]" << '\n';
+
+    using Clock = std::chrono::steady_clock;
+    const auto milliseconds = [] (Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+    for (std::string input = snippet; input.length() <= max_length; input += input) {
+        const auto start = Clock::now();
+        const ParseForest forest = parser.parseForest(toTerminals(input));
+        const auto built = Clock::now();
+        const std::uint64_t derivations = forest.countDerivations();
+        const auto counted = Clock::now();
+        ProductionTree tree;
+        const bool success = forest.trees().next(tree);
+        const auto taken = Clock::now();
+
+        std::cout << std::setw(10) << input.length() << std::setw(12) << forest.size() << std::setw(14);
+        if (derivations == ParseForest::MANY) {
+            std::cout << "many";
+        } else {
+            std::cout << derivations;
+        }
+        std::cout << std::setw(12) << std::fixed << std::setprecision(2) << milliseconds(built - start)
+                  << std::setw(12) << milliseconds(counted - built) << std::setw(12) << milliseconds(taken - counted)
+                  << (success ? "" : "  (rejected)") << '\n';
+    }
+
+    return 0;
+}
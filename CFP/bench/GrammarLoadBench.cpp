@@ -0,0 +1,99 @@
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "CompiledGrammar.hpp"
+#include "Grammar.hpp"
+#include "GrammarImage.hpp"
+
+using namespace cfg;
+
+// Measures how long loading a grammar takes for generated grammars of growing size:
+// reading and parsing the file, and compiling the result for the Earley parser, as
+// well as converting it to CNF for the CYK parser. Both are compared to loading the
+// same grammar from a precompiled image, for either parser.
+// The grammars are chains of statement-like nonterminals, each with a handful of
+// alternatives mixing nonterminals further down the chain, keywords, escaped
+// strings and character classes, so that every one of them terminates. Every
+// alternative starts with a terminal, which keeps the prediction closures small:
+// they grow with the left corners of a grammar, not with the time it takes to read it.
+//
+// usage: grammar_load_bench [max rules] [scratch file]; the image goes next to the scratch file
+
+static void generate(const std::string &filename, unsigned nonterminals) {
+    static const char *const CLASSES[] = { "[a-z]", "[0-9]", "[^\"\\\\]", "." };
+
+    std::mt19937 random(nonterminals);
+    std::ofstream file(filename);
+
+    file << "# generated grammar, " << nonterminals << " nonterminals\n";
+    file << "S -> N0 | S ';' N0\n";
+    for (unsigned n = 0; n < nonterminals; n++) {
+        auto below = [&] () { return "N" + std::to_string(n + 1 + random() % std::min(8u, nonterminals - n - 1)); };
+
+        file << "N" << n << " -> ";
+        if (n + 1 == nonterminals) {
+            file << "'leaf' | " << CLASSES[random() % 4] << '\n';
+            continue;
+        }
+        file << "\"kw" << n << "\" " << below() << " '(' " << below() << " ')'";
+        file << " | '<' " << below() << " \"\\\"op" << n % 97 << "\\\"\" " << below();
+        file << " | " << CLASSES[random() % 4] << ' ' << below();
+        file << " | '-' " << below() << '\n';
+    }
+}
+
+int main(int argc, char **argv) {
+
+    const unsigned max_rules = argc > 1 ? std::stoul(argv[1]) : 1 << 17;
+    const std::string filename = argc > 2 ? argv[2] : "/tmp/grammar_load_bench.grammar";
+
+    const std::string image_filename = filename + ".image";
+
+    auto milliseconds = [] (auto from, auto to) { return std::chrono::duration<double, std::milli>(to - from).count(); };
+
+    std::cout << std::setw(10) << "rules" << std::setw(12) << "bytes" << std::setw(12) << "load [ms]"
+              << std::setw(14) << "compile [ms]" << std::setw(14) << "rules/sec" << std::setw(10) << "cnf [ms]"
+              << std::setw(16) << "image [ms]" << std::setw(16) << "image cnf [ms]" << '\n';
+
+    for (unsigned rules = 1 << 10; rules <= max_rules; rules *= 2) {
+        generate(filename, rules / 4);
+
+        const auto start = std::chrono::steady_clock::now();
+        GrammarManager gm;
+        gm.parseFromFile(filename);
+        const auto loaded = std::chrono::steady_clock::now();
+        const CompiledGrammar cg(gm);
+        const auto compiled = std::chrono::steady_clock::now();
+
+        const GrammarManager cnf = gm.toCNF();
+        const auto converted = std::chrono::steady_clock::now();
+
+        GrammarImage::write(gm, image_filename, true);
+
+        const auto image_start = std::chrono::steady_clock::now();
+        {
+            const GrammarImage image(image_filename);
+            const GrammarManager image_gm = image.getGrammar();
+            image.getCompiledGrammar(image_gm);
+        }
+        const auto image_loaded = std::chrono::steady_clock::now();
+        GrammarImage(image_filename).getCNF();
+        const auto image_converted = std::chrono::steady_clock::now();
+
+        const double load = milliseconds(start, loaded), compile = milliseconds(loaded, compiled);
+
+        std::cout << std::setw(10) << cg.getRules().rules.size() << std::setw(12) << std::ifstream(filename, std::ios::ate).tellg()
+                  << std::setw(12) << std::fixed << std::setprecision(2) << load
+                  << std::setw(14) << compile
+                  << std::setw(14) << std::setprecision(0) << cg.getRules().rules.size() / (load + compile) * 1e3
+                  << std::setw(10) << std::setprecision(2) << milliseconds(compiled, converted)
+                  << std::setw(16) << milliseconds(image_start, image_loaded)
+                  << std::setw(16) << milliseconds(image_loaded, image_converted) << '\n';
+    }
+
+    return 0;
+}
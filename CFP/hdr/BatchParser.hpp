@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+
+#include "Grammar.hpp"
+#include "Parser.hpp"
+
+namespace cfg {
+
+    // Parses many independent inputs with one parser on a pool of <threads> threads and
+    // returns whether each was accepted, in input order. Every thread starts on its own
+    // contiguous share of the inputs and takes them from the front; once its share is
+    // used up it steals the back half of the largest share left, so threads that got
+    // the cheap inputs help out with the expensive ones until all are done.
+    // CONTRACT: the grammar of <parser> is initialized and nothing changes the parser meanwhile
+    std::vector<bool> parseBatch(const Parser &parser, const std::vector<String> &inputs, unsigned threads);
+
+} // namespace cfg
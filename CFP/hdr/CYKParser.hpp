@@ -1,5 +1,9 @@
 #pragma once
 
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
 #include "Grammar.hpp"
 #include "Parser.hpp"
 
@@ -11,12 +15,20 @@ namespace cfg {
 
         GrammarManager gm;
 
+        // the nonterminals with a rule A -> t for every terminal t, and with a rule
+        // A -> B C for every pair of nonterminals (B << 32 | C), in grammar order
+        std::unordered_map<Terminal, std::vector<Nonterminal>> terminal_rules;
+        std::unordered_map<std::uint64_t, std::vector<Nonterminal>> binary_rules;
+
     public:
 
         CYKParser();
 
         virtual void initGrammar(const std::string &filename);
-        virtual bool parseInput(const std::vector<Terminal> &input);
+        inline virtual Terminal getToken(const std::string &name) const { return gm.getToken(name); }
+
+        using Parser::parseInput;
+        virtual bool parseInput(const std::vector<Terminal> &input, ParseWorkspace &workspace) const;
     };
 
-} // namespace cfg
\ No newline at end of file
+} // namespace cfg
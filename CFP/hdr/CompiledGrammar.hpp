@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstring>
+#include <vector>
+
+#include "Grammar.hpp"
+
+namespace cfg {
+
+    // Everything the parsers derive from a grammar before looking at any input: the
+    // rule table (augmented with the root rule ^ -> S), its character classes and literals, the
+    // nullable nonterminals, the FIRST and FOLLOW sets, FIRST and nullability of the
+    // rest of every dotted rule, the prediction closures and the smallest derivation
+    // of the empty word for every nullable nonterminal, and what refining a tree does
+    // with every rule and nonterminal. It is computed once when the grammar is loaded and
+    // never changed afterwards, so a single instance can be shared by all parses.
+    class CompiledGrammar {
+
+    private:
+
+        RuleTable rules;
+        unsigned root_rule;
+        Terminal alphabet;
+        std::vector<CharacterClass> classes;
+        std::vector<TerminalSet> class_sets; // the classes over the whole alphabet
+        std::vector<String> literals;
+        unsigned window;
+
+        std::vector<bool> nullable;
+        std::vector<TerminalSet> first;
+        std::vector<TerminalSet> follow;
+
+        // indexed by item_offset[rule] + dot, for every dot position 0..|rule|
+        std::vector<unsigned> item_offset;
+        std::vector<bool> suffix_nullable;
+        std::vector<TerminalSet> suffix_first;
+
+        std::vector<std::vector<std::pair<unsigned, unsigned>>> predictions;
+        std::vector<std::vector<Nonterminal>> closures;
+
+        std::vector<ProductionTree> null_trees;
+        std::vector<unsigned> null_rules; // the rule at the root of every null tree
+
+        std::vector<bool> full_resolve;   // indexed by rule: written with *>
+        std::vector<char> omitted;        // indexed by nonterminal: CLEAR_RULE, DELETE_RULE or 0
+
+    private:
+
+        void computeNullable();
+        void computeFirst();
+        void computeSuffixSets();
+        void computeFollow();
+        void computeClosures();
+        void computeNullTrees();
+        void computeRefinement(const GrammarManager &gm);
+
+    public:
+
+        // the sets computed as fixed points over the whole grammar, the costliest part of
+        // compiling it, which a grammar image stores
+        struct FixedPoints {
+            std::vector<bool> nullable;
+            std::vector<TerminalSet> first, follow;
+        };
+
+        CompiledGrammar(const GrammarManager &gm);
+
+        // takes the fixed points as given rather than computing them again
+        // CONTRACT: they are those of <gm>, as isNullable(), getFirst() and getFollow() return them
+        CompiledGrammar(const GrammarManager &gm, FixedPoints sets);
+
+        inline const RuleTable &getRules() const { return rules; }
+        inline unsigned getRootRule() const { return root_rule; }
+        inline Nonterminal getNonterminalCount() const { return nullable.size(); }
+        inline Terminal getAlphabetSize() const { return alphabet; }
+
+        inline const Rule &getRule(unsigned rule) const { return rules.rules[rule]; }
+        inline Nonterminal getFrom(unsigned rule) const { return rules.from[rule]; }
+        inline std::pair<unsigned, unsigned> getRange(Nonterminal n) const { return rules.ranges[n]; }
+
+        inline const CharacterClass &getClass(unsigned cls) const { return classes[cls]; }
+
+        inline const String &getLiteral(unsigned literal) const { return literals[literal]; }
+
+        // whether <t> is the first terminal terminal symbol <s> may read
+        // CONTRACT: <s> is a terminal symbol
+        inline bool matches(const Symbol &s, Terminal t) const {
+            return s.cls == NO_CLASS ? s.t == t : contains(classes[s.cls], t);
+        }
+
+        // the number of terminals a scan of terminal symbol <s> reads
+        inline unsigned getLength(const Symbol &s) const {
+            return s.literal == NO_LITERAL ? 1 : literals[s.literal].size();
+        }
+
+        // the most terminals a single scan reads: a column can be processed once the
+        // input that far from it is known, or known to end before
+        inline unsigned getScanWindow() const { return window; }
+
+        // whether terminal symbol <s> matches the input at <input>, of which <available>
+        // terminals are known; a literal is compared in one go
+        // CONTRACT: <s> is a terminal symbol, <available> is at least 1
+        inline bool scans(const Symbol &s, const Terminal *input, std::size_t available) const {
+            if (s.literal == NO_LITERAL) {
+                return matches(s, *input);
+            }
+            const String &literal = literals[s.literal];
+            return available >= literal.size() && std::memcmp(literal.data(), input, literal.size() * sizeof(Terminal)) == 0;
+        }
+
+        inline bool isNullable(Nonterminal n) const { return nullable[n]; }
+        inline const TerminalSet &getFirst(Nonterminal n) const { return first[n]; }
+        inline const TerminalSet &getFollow(Nonterminal n) const { return follow[n]; }
+
+        // FIRST and nullability of the symbols of <rule> from <dot> on
+        inline bool isNullableSuffix(unsigned rule, unsigned dot) const { return suffix_nullable[item_offset[rule] + dot]; }
+        inline const TerminalSet &getSuffixFirst(unsigned rule, unsigned dot) const { return suffix_first[item_offset[rule] + dot]; }
+
+        // the dotted rules (rule, dot) predicting <n> adds to a column: every rule of <n>
+        // with the dot at its beginning or behind a prefix of nullable nonterminals
+        inline const std::vector<std::pair<unsigned, unsigned>> &getPredictions(Nonterminal n) const { return predictions[n]; }
+
+        // <n> and every nonterminal that predicting it predicts in turn, directly or
+        // behind nullable nonterminals
+        inline const std::vector<Nonterminal> &getClosure(Nonterminal n) const { return closures[n]; }
+
+        // CONTRACT: <n> is nullable
+        inline const ProductionTree &getNullTree(Nonterminal n) const { return null_trees[n]; }
+
+        // CONTRACT: <n> is nullable
+        inline unsigned getNullRule(Nonterminal n) const { return null_rules[n]; }
+
+        // whether the nonterminals of <rule> give way to the symbols and subtrees of
+        // their own nodes when a tree is refined
+        inline bool isFullResolve(unsigned rule) const { return full_resolve[rule]; }
+
+        // whether the nodes of <n> lose their subtrees when a tree is refined, and
+        // whether they disappear from the rules of their parents as well
+        inline bool isCleared(Nonterminal n) const { return n < omitted.size() && omitted[n] != 0; }
+        inline bool isDeleted(Nonterminal n) const { return n < omitted.size() && omitted[n] == DELETE_RULE; }
+
+        // refines a node whose subtrees are refined already: under a *> rule, every
+        // nonterminal gives way to the symbols and subtrees of its node, and a %
+        // nonterminal disappears from the rule along with its subtree
+        void refineNode(ProductionTree &tree, bool full_resolve) const;
+    };
+
+} // namespace cfg
@@ -1,25 +1,172 @@
 #pragma once
 
+#include <chrono>
+#include <memory>
+
+#include "CompiledGrammar.hpp"
 #include "Grammar.hpp"
+#include "ParseForest.hpp"
+#include "ParseWorkspace.hpp"
 #include "Parser.hpp"
+#include "SyntaxTree.hpp"
 
 namespace cfg {
 
     const ProductionTree FAILED_PARSE = { FAIL, Rule{}, std::vector<ProductionTree>{} };
 
+    // size of the Earley table and time spent in the recognizer for a single parse
+    struct ParseStatistics {
+        std::size_t columns = 0, items = 0, maxColumnSize = 0;
+        std::chrono::nanoseconds recognizeTime{ 0 };
+    };
+
     class EarleyParser : public Parser {
 
+    public:
+
+        // Parses one input that arrives in chunks: every column whose next characters
+        // are known, as many as the longest literal of the grammar, is processed as
+        // soon as they are fed, so parsing overlaps with reading, and running out of
+        // items to scan ends the session early.
+        // CONTRACT: the parser outlives its sessions and keeps its grammar meanwhile
+        class Session {
+
+            friend class EarleyParser;
+
+        private:
+
+            struct State; // the columns, defined next to the Earley table
+            std::unique_ptr<State> state;
+
+            Session(EarleyParser *parser);
+
+        public:
+
+            Session(Session &&);
+            Session &operator = (Session &&);
+            ~Session();
+
+            // returns false once the input read so far is no prefix of a sentence
+            bool feed(const String &chunk);
+
+            bool isViablePrefix() const;
+
+            // true if the input read so far is a sentence; more input may follow
+            bool acceptsHere() const;
+
+            // ends the input; the session takes no more chunks afterwards
+            std::pair<bool, ProductionTree> finish();
+        };
+
+        // Decides whether one input that arrives in chunks is a sentence without a
+        // table, backpointers or a tree. Of a processed column only the items that a
+        // completion may still advance are kept, and only as long as a live item
+        // started there, so memory follows the number of live origins (about the
+        // nesting depth of the input) rather than its length.
+        // CONTRACT: the parser outlives its recognizers and keeps its grammar meanwhile
+        class Recognizer {
+
+            friend class EarleyParser;
+
+        private:
+
+            struct State; // the live columns, defined next to the Earley table
+            std::unique_ptr<State> state;
+
+            Recognizer(const EarleyParser *parser);
+
+        public:
+
+            Recognizer(Recognizer &&);
+            Recognizer &operator = (Recognizer &&);
+            ~Recognizer();
+
+            // returns false once the input read so far is no prefix of a sentence
+            bool feed(const String &chunk);
+
+            bool isViablePrefix() const;
+
+            // ends the input and returns whether it is a sentence
+            bool finish();
+
+            // the columns kept right now and at most so far
+            std::size_t getLiveColumns() const;
+            std::size_t getPeakColumns() const;
+        };
+
+        // Keeps the text of an editor buffer together with its Earley table. An edit
+        // keeps the columns before it, reprocesses from there, and takes the rest of
+        // the old table over as soon as a column after the inserted text holds the same
+        // items as its old counterpart, started in columns that correspond as well.
+        // CONTRACT: the parser outlives its documents and keeps its grammar meanwhile
+        class Document {
+
+            friend class EarleyParser;
+
+        private:
+
+            struct State; // the text and its table, defined next to the Earley table
+            std::unique_ptr<State> state;
+
+            Document(EarleyParser *parser);
+
+        public:
+
+            Document(Document &&);
+            Document &operator = (Document &&);
+            ~Document();
+
+            // replaces the whole text; returns whether it is accepted
+            bool assign(const String &input);
+
+            // replaces <removed> characters at <offset> with <inserted>; returns whether
+            // the new text is accepted
+            bool edit(std::size_t offset, std::size_t removed, const String &inserted);
+
+            bool accepted() const;
+            const String &getInput() const;
+
+            // the number of columns the last assign() or edit() processed
+            std::size_t getProcessedColumns() const;
+
+            std::pair<bool, ProductionTree> tree();
+        };
+
     private:
 
         GrammarManager gm;
+        std::shared_ptr<const CompiledGrammar> grammar;
 
     public:
 
         EarleyParser();
 
         virtual void initGrammar(const std::string &filename);
-        virtual bool parseInput(const String &input);
-        std::pair<bool, ProductionTree> parseTree(const String &input);
+        inline virtual Terminal getToken(const std::string &name) const { return gm.getToken(name); }
+        using Parser::parseInput;
+        virtual bool parseInput(const String &input, ParseWorkspace &workspace) const;
+        std::pair<bool, ProductionTree> parseTree(const String &input, ParseStatistics *statistics = nullptr) const;
+
+        // the tree parseTree() builds before refining it, stored flat; empty if <input> is
+        // rejected. CONTRACT: <input> outlives the tree, whose terminals are views of it
+        SyntaxTree parseSyntaxTree(const String &input) const;
+
+        // decides whether <input> is a sentence without building its table or tree
+        bool accepts(const String &input) const;
+        bool accepts(const String &input, ParseWorkspace &workspace) const;
+
+        Recognizer startRecognizer() const;
+        Session startSession();
+        Document openDocument();
+
+        // every derivation of the input; the forest is empty if the input is rejected
+        ParseForest parseForest(const String &input) const;
+
+        // applies the refinement parseTree() does to a tree taken from a forest
+        ProductionTree refineTree(const ProductionTree &tree) const;
+
+        // writes a tree of parseTree() or refineTree() to <out> in <format>
+        void writeTree(std::ostream &out, const ProductionTree &tree, TreeFormat format) const;
     };
 
 } // namespace cfg
\ No newline at end of file
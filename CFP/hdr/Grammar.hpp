@@ -1,9 +1,14 @@
 #pragma once
 
+#include <bitset>
+#include <climits>
+#include <cstdint>
 #include <map>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "Lexer.hpp"
@@ -20,17 +25,83 @@ namespace cfg {
         return false;
     }
 
-    using Terminal = char;
+    // The terminals below CHARACTERS are the characters (as unsigned char) of a text
+    // input, the ones from CHARACTERS on the tokens of an external lexer, written @name
+    // in a grammar. Inputs of either kind are strings of terminal ids.
+    using Terminal = std::uint32_t;
     using Nonterminal = unsigned;
 
     constexpr Nonterminal S = 0, ROOT = -1, FAIL = -2;
+    constexpr Terminal CHARACTERS = 1 << CHAR_BIT;
 
+    using CharacterClass = std::bitset<CHARACTERS>;
+
+    inline bool contains(const CharacterClass &set, Terminal t) {
+        return t < CHARACTERS && set.test(t);
+    }
+
+    // a set of terminals of an alphabet of <size> terminals, one bit each
+    class TerminalSet {
+
+    private:
+
+        std::vector<std::uint64_t> words;
+
+    public:
+
+        TerminalSet(Terminal size = 0) : words((size + 63) / 64, 0) {}
+
+        // the set stored as getWords() returned it
+        explicit TerminalSet(std::vector<std::uint64_t> words) : words(std::move(words)) {}
+
+        // the bits of the set, 64 terminals per word, lowest terminal in the lowest bit
+        inline const std::vector<std::uint64_t> &getWords() const { return words; }
+
+        inline bool test(Terminal t) const {
+            return t / 64 < words.size() && (words[t / 64] >> (t % 64) & 1);
+        }
+
+        // CONTRACT: <t> lies in the alphabet
+        inline void set(Terminal t) { words[t / 64] |= std::uint64_t{ 1 } << (t % 64); }
+
+        inline void set(const CharacterClass &cls) {
+            for (Terminal c = 0; c < CHARACTERS; c++) {
+                if (cls.test(c)) {
+                    set(c);
+                }
+            }
+        }
+
+        // CONTRACT: both sets have the same alphabet
+        inline TerminalSet &operator |= (const TerminalSet &other) {
+            for (std::size_t i = 0; i < words.size(); i++) {
+                words[i] |= other.words[i];
+            }
+            return *this;
+        }
+
+        inline bool operator == (const TerminalSet &other) const { return words == other.words; }
+        inline bool operator != (const TerminalSet &other) const { return words != other.words; }
+    };
+
+    inline bool contains(const TerminalSet &set, Terminal t) {
+        return set.test(t);
+    }
+
+    constexpr unsigned NO_CLASS = -1, NO_LITERAL = -1;
+
+    // a terminal symbol with a character class <cls> stands for every character of
+    // the grammar's class <cls> rather than for <t> alone; one with a literal stands
+    // for the whole run of terminals of the grammar's literal <literal>, which starts
+    // with <t>, and is scanned in one step
     struct Symbol {
         bool isTerminal;
         union { Terminal t; Nonterminal n; };
+        unsigned cls = NO_CLASS;
+        unsigned literal = NO_LITERAL;
 
         inline bool operator == (const Symbol &s) const {
-            return isTerminal == s.isTerminal && (isTerminal ? (t == s.t) : (n == s.n));
+            return isTerminal == s.isTerminal && (isTerminal ? (t == s.t && cls == s.cls && literal == s.literal) : (n == s.n));
         }
     };
 
@@ -40,6 +111,14 @@ namespace cfg {
     using Symbols = std::vector<Symbol>;
     using String = std::vector<Terminal>;
 
+    // all production rules of a grammar numbered consecutively; the rules of nonterminal
+    // n occupy the range [ranges[n].first, ranges[n].second) of rule ids
+    struct RuleTable {
+        std::vector<Nonterminal> from;
+        std::vector<Rule> rules;
+        std::vector<std::pair<unsigned, unsigned>> ranges;
+    };
+
     struct ProductionTree {
         Nonterminal from;
         Rule rule;
@@ -48,14 +127,39 @@ namespace cfg {
 
     constexpr char CLEAR_RULE = '&', DELETE_RULE = '%';
 
+    // the characters of <s>, each as the terminal of its unsigned char
     std::vector<Terminal> toTerminals(const std::string &s);
 
+    // parses a character class token such as [a-zA-Z_], [^"] or .
+    CharacterClass parseClass(std::string_view text);
+
+    // the class in the same notation: "." for every character, otherwise the ranges of
+    // the class or of its complement, whichever is shorter
+    std::string classToString(const CharacterClass &set);
+
     std::map<Nonterminal, bool> getTerminateMap(const Grammar &g);
 
+    RuleTable getRuleTable(const Grammar &g);
+
+    // the notations GrammarManager::writeTree() writes a tree in:
+    //   TEXT         the indented listing printTree() returns, for reading
+    //   JSON         {"nonterminal":"Sum","children":[{"nonterminal":"Num","children":["1"]},"+",...]},
+    //                a terminal as the string of its text, a token as {"token":"NUM"} and a
+    //                missing subtree as null
+    //   SEXPRESSION  (Sum (Num "1") "+" ...), a token as @NUM and a missing subtree as ()
+    //   BINARY       the nodes in preorder as LEB128 varints: a node as its nonterminal
+    //                shifted left by one, followed by the number of its children; a terminal
+    //                as its id shifted left by one with the lowest bit set, every terminal of
+    //                a literal on its own; a missing subtree as a node of nonterminal FAIL
+    // Text goes out byte for byte, bytes of 0x80 and above included.
+    enum class TreeFormat { TEXT, JSON, SEXPRESSION, BINARY };
+
     class GrammarManager {
 
         friend class CYKParser;
         friend class EarleyParser;
+        friend class CompiledGrammar;
+        friend class GrammarImage;
 
     private:
 
@@ -66,19 +170,37 @@ namespace cfg {
         using omit = int8_t;
 
         Grammar g, fullresolveRules;
+        std::vector<CharacterClass> classes;
+        std::vector<String> literals;
+        std::map<String, unsigned> literal_index_map;
         std::unordered_map<Nonterminal, omit> clearProductions, deleteProductions;
 
         std::map<Nonterminal, bool> termination_map;
 
-        std::map<std::string, Nonterminal> nonterminal_index_map;
+        // std::less<> looks names up by the views the lexer hands out, without copying them;
+        // the names vectors map back from the ids, empty where an id has no name
+        std::map<std::string, Nonterminal, std::less<>> nonterminal_index_map;
+        std::vector<std::string> nonterminal_names;
         Nonterminal nonterminal_maxindex;
 
+        // the tokens are numbered from CHARACTERS on, in the order they first appear
+        std::map<std::string, Terminal, std::less<>> token_index_map;
+        std::vector<std::string> token_names; // indexed by token - CHARACTERS
+        Terminal token_maxindex;
+
     private:
 
-        Nonterminal addNonterminal(const std::string &name);
-        std::vector<std::tuple<Token::Type, Nonterminal, Rule, char>> parseProductionRule(const std::string &line);
+        void nameNonterminal(std::string_view name, Nonterminal n);
+        void nameToken(std::string_view name, Terminal t);
+        Nonterminal addNonterminal(std::string_view name);
+        Terminal addToken(std::string_view name);
+        unsigned addClass(const CharacterClass &set);
+        unsigned addLiteral(const String &run);
+        std::vector<std::tuple<Token::Type, Nonterminal, Rule, char>> parseProductionRule(std::string_view line);
+        void parseLines(const std::vector<std::string_view> &lines);
 
         std::string getNonterminalName(Nonterminal n) const;
+        std::string getTerminalName(const Symbol &s) const;
 
         void reset();
 
@@ -87,10 +209,23 @@ namespace cfg {
         GrammarManager();
         GrammarManager(const Grammar &g);
         GrammarManager(const GrammarManager &other);
+        GrammarManager(GrammarManager &&) = default;
+        GrammarManager &operator = (const GrammarManager &) = default;
+        GrammarManager &operator = (GrammarManager &&) = default;
 
         inline Grammar getGrammar() const { return g; }
 
+        // the number of terminal ids the grammar uses: the characters and its tokens
+        inline Terminal getAlphabetSize() const { return token_maxindex; }
+
+        // the terminal id of token @<name>, for the lexer that feeds the parser; throws
+        // if the grammar doesn't use the token
+        Terminal getToken(const std::string &name) const;
+
         void parse(const std::vector<std::string> &lines);
+
+        // maps the file into memory and parses its lines in place; does nothing if the
+        // file can't be opened
         void parseFromFile(const std::string &filename);
 
         bool terminates();
@@ -98,8 +233,11 @@ namespace cfg {
 
         GrammarManager toCNF() const;
 
-        ProductionTree refineTree(const ProductionTree &tree);
-        std::string printTree(const ProductionTree &tree, const std::string indent = "");
+        std::string printTree(const ProductionTree &tree) const;
+
+        // writes <tree> to <out> in a single pass, straight into its buffer and without
+        // recursion, so neither the depth of a tree nor its size is paid for twice
+        void writeTree(std::ostream &out, const ProductionTree &tree, TreeFormat format) const;
 
         std::string debugInfo();
     };
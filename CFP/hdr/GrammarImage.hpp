@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "CompiledGrammar.hpp"
+#include "Grammar.hpp"
+#include "MappedFile.hpp"
+
+namespace cfg {
+
+    // A grammar compiled ahead of time into a binary file, so that loading it needs
+    // neither lexing nor the checks, fixed points and CNF conversion a grammar file
+    // goes through. The file starts with a versioned header, followed by sections at
+    // the offsets the header gives:
+    //   GRAMMAR   the grammar as parsed: its rules with their refinement flags (*>, &
+    //             and %), classes, literals and the names of its nonterminals and tokens
+    //   CNF       the grammar in Chomsky normal form, for the CYK parser; optional, since
+    //             the conversion doesn't finish for every grammar the Earley parser takes
+    //   COMPILED  the nullable nonterminals, FIRST and FOLLOW sets of the grammar
+    // A section is a sequence of 32-bit words in the byte order of the machine that
+    // wrote it; nothing in it refers to addresses, so the file is read where it is
+    // mapped. Everything read is checked against the bounds of the file and of the
+    // grammar, so a damaged image is an error rather than a broken grammar. A section
+    // left out has size 0.
+    class GrammarImage {
+
+    public:
+
+        static constexpr std::uint32_t VERSION = 1;
+
+        enum Section : unsigned { GRAMMAR, CNF, COMPILED, SECTIONS };
+
+    private:
+
+        MappedFile file;
+        std::string_view sections[SECTIONS];
+
+    private:
+
+        static void writeGrammar(std::vector<std::uint32_t> &words, const GrammarManager &gm);
+        static GrammarManager readGrammar(std::string_view section);
+
+    public:
+
+        // maps the image; throws if it can't be opened or isn't a grammar image of this version
+        GrammarImage(const std::string &filename);
+
+        GrammarManager getGrammar() const;
+        GrammarManager getCNF() const;
+
+        // whether the image holds the CNF section; without it, getCNF() converts the grammar
+        inline bool hasCNF() const { return !sections[CNF].empty(); }
+
+        // CONTRACT: <gm> is the grammar getGrammar() returned
+        std::shared_ptr<const CompiledGrammar> getCompiledGrammar(const GrammarManager &gm) const;
+
+        // whether <filename> starts like a grammar image, of whatever version
+        static bool isImage(const std::string &filename);
+
+        // compiles <gm> and writes it to <filename>, with its CNF if <cnf>; throws if the
+        // file can't be written
+        static void write(const GrammarManager &gm, const std::string &filename, bool cnf = false);
+    };
+
+} // namespace cfg
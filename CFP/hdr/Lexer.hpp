@@ -2,14 +2,17 @@
 
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace cfg {
 
     struct Token {
-        std::string text;
+        std::string_view text; // a view into the lexed line
         enum class Type {
-            STRING,
+            STRING,         // the text between the quotes, escapes unresolved
+            CLASS,          // [a-z], [^"] or .
+            TOKEN,          // @name, the text without the @
             NONTERMINAL,
             EPSILON,        // €
             PIPE,           // |
@@ -18,6 +21,12 @@ namespace cfg {
         } type;
     };
 
-    std::vector<Token> lex(const std::string &line);
+    // the tokens of <line> in a single pass, without copying any text; a # outside of
+    // strings and classes comments out the rest of the line
+    std::vector<Token> lex(std::string_view line);
+
+    // the text of a string token with its escapes \\ \' \" \n \t resolved
+    // CONTRACT: every backslash of <text> starts one of these escapes, as in a lexed string
+    std::string unescape(std::string_view text);
 
 } // namespace cfg
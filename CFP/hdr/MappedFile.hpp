@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace cfg {
+
+    // A file mapped into memory read-only for as long as the object lives. A file that
+    // can't be mapped, such as a pipe, is read into a buffer instead; either way its
+    // contents stay put until the object is destroyed.
+    class MappedFile {
+
+    private:
+
+        void *data;
+        std::size_t size = 0;
+        std::string buffer;
+        bool open = false;
+
+    public:
+
+        MappedFile(const std::string &filename);
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator = (const MappedFile &) = delete;
+        ~MappedFile();
+
+        // false if the file couldn't be opened, in which case it has no contents
+        inline bool isOpen() const { return open; }
+
+        std::string_view contents() const;
+    };
+
+} // namespace cfg
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "CompiledGrammar.hpp"
+#include "Grammar.hpp"
+
+namespace cfg {
+
+    // Binarised shared packed parse forest (SPPF) holding every derivation of one
+    // input in polynomial space. Nodes are unique per (kind, rule or nonterminal,
+    // dot, span); each packed node of a node is one way to derive it:
+    //   SYMBOL   <id> over [start, end): packed nodes (NONE, complete ITEM of <id>)
+    //   ITEM     rule <id> with the dot before symbol <dot> over [start, end), dot >= 1:
+    //            packed nodes (ITEM of the same rule one symbol shorter or NONE if
+    //            dot == 1, node of the symbol before the dot)
+    //   TERMINAL the input terminals [start, end) a terminal symbol (a literal or
+    //            one character or token) matched, the first of which is <id>
+    //   NULLED   nonterminal <id> deriving the empty word at <start>; all derivations
+    //            of the empty word are represented by the grammar's null tree
+    class ParseForest {
+
+    public:
+
+        static constexpr unsigned NONE = UINT_MAX;
+
+        // derivation count of forests with a cycle or more derivations than fit
+        static constexpr std::uint64_t MANY = UINT64_MAX;
+
+        enum class NodeType { SYMBOL, ITEM, TERMINAL, NULLED };
+
+        struct Node {
+            NodeType type;
+            unsigned id, dot;
+            unsigned start, end;
+            std::vector<std::pair<unsigned, unsigned>> packed;
+        };
+
+        // Enumerates the derivation trees of a forest one at a time, like an odometer
+        // over the packed node chosen at each ambiguous node in depth-first order.
+        // Trees that would contain a node within itself (only possible with cyclic
+        // grammars) are skipped, so the enumeration always ends.
+        class TreeIterator {
+
+        private:
+
+            const ParseForest *forest;
+            std::vector<std::pair<unsigned, unsigned>> choices; // (chosen, alternatives)
+            unsigned depth;
+            std::vector<bool> on_path;
+            bool exhausted;
+
+        private:
+
+            bool choose(unsigned node, unsigned &chosen);
+            bool buildItem(unsigned node, ProductionTree &tree);
+            bool step();
+
+        public:
+
+            TreeIterator(const ParseForest &forest);
+
+            // stores the next derivation tree in <tree>, or returns false if there is none
+            bool next(ProductionTree &tree);
+        };
+
+    private:
+
+        std::shared_ptr<const CompiledGrammar> grammar;
+        std::vector<Node> nodes;
+        unsigned root;
+
+    public:
+
+        ParseForest();
+        ParseForest(std::shared_ptr<const CompiledGrammar> grammar, std::vector<Node> nodes, unsigned root);
+
+        // true if the input was rejected
+        inline bool empty() const { return root == NONE; }
+        inline std::size_t size() const { return nodes.size(); }
+        inline unsigned getRoot() const { return root; }
+        inline const Node &getNode(unsigned node) const { return nodes[node]; }
+
+        // number of derivation trees, computed on the shared nodes without expanding
+        // them; MANY if there are infinitely many or the count overflows
+        std::uint64_t countDerivations() const;
+
+        // the trees are rooted in the root rule ^ -> S and not refined
+        inline TreeIterator trees() const { return TreeIterator(*this); }
+    };
+
+} // namespace cfg
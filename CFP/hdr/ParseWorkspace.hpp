@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "Grammar.hpp"
+
+namespace cfg {
+
+    // The buffers a parse works in. Callers that parse many inputs keep one workspace
+    // per thread and pass it to every parse: the buffers are cleared between parses
+    // but keep their capacity, so once they have grown to the largest input seen,
+    // parsing allocates nothing more. A workspace can go from one parser to another,
+    // but only serves one parse at a time.
+    class ParseWorkspace {
+
+        friend class CYKParser;
+        friend class EarleyParser;
+
+    private:
+
+        struct Recognition; // the Earley recognizer, defined next to it
+        std::unique_ptr<Recognition> recognition;
+
+        // the cells of the CYK table, cell (x, y) at x * (x + 1) / 2 + y
+        std::vector<std::vector<Nonterminal>> cells;
+
+    public:
+
+        ParseWorkspace();
+        ParseWorkspace(ParseWorkspace &&);
+        ParseWorkspace &operator = (ParseWorkspace &&);
+        ~ParseWorkspace();
+    };
+
+} // namespace cfg
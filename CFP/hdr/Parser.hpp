@@ -1,14 +1,36 @@
 #pragma once
 
 #include "Grammar.hpp"
+#include "ParseWorkspace.hpp"
+#include "Trace.hpp"
 
 namespace cfg {
 
     class Parser {
 
+    protected:
+
+        TraceSink *trace = nullptr;
+
     public:
 
         virtual void initGrammar(const std::string &input) = 0;
-        virtual bool parseInput(const std::vector<Terminal> &input) = 0;
+
+        // the terminal id of token @<name> of the grammar, so a lexer can feed the
+        // parser token ids rather than characters; throws if the grammar has no such token
+        virtual Terminal getToken(const std::string &name) const = 0;
+
+        // CONTRACT: the grammar is initialized; parsing only reads the parser, so one
+        // parser can serve several threads at once, each with a workspace of its own
+        virtual bool parseInput(const std::vector<Terminal> &input, ParseWorkspace &workspace) const = 0;
+
+        // parses in a workspace that is released afterwards
+        inline bool parseInput(const std::vector<Terminal> &input) const {
+            ParseWorkspace workspace;
+            return parseInput(input, workspace);
+        }
+
+        // diagnostics go to <sink> from now on; nullptr (the default) disables them
+        inline void setTraceSink(TraceSink *sink) { trace = sink; }
     };
-}
\ No newline at end of file
+}
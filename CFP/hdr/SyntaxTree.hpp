@@ -0,0 +1,154 @@
+#pragma once
+
+#include <climits>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "CompiledGrammar.hpp"
+#include "Grammar.hpp"
+
+namespace cfg {
+
+    // Concrete syntax tree of one parse, stored flat: every node is a rule of the
+    // compiled grammar over a span [begin, end) of the input, with the index of its
+    // first child and of its next sibling, so the tree takes a single vector of as
+    // many small nodes as it has rather than a rule and a vector of subtrees per node.
+    // The root is node 0, of the root rule ^ -> S. Terminals are not stored: the text
+    // of a terminal symbol or of a whole node is a view of the input, which is why the
+    // input has to outlive the tree. A nullable nonterminal that derived the empty word
+    // has its null tree spelled out in nodes of empty spans. The tree is not refined.
+    class SyntaxTree {
+
+    public:
+
+        static constexpr unsigned NONE = UINT_MAX;
+
+        struct Node {
+            unsigned rule;
+            unsigned begin, end;
+            unsigned first_child, next_sibling;
+        };
+
+        using Text = std::span<const Terminal>;
+
+        // the children of a node in the order of their symbols in its rule
+        class Children {
+
+        private:
+
+            const SyntaxTree *tree;
+            unsigned first;
+
+        public:
+
+            class iterator {
+
+            private:
+
+                const SyntaxTree *tree;
+                unsigned node;
+
+            public:
+
+                using iterator_category = std::forward_iterator_tag;
+                using value_type = unsigned;
+                using difference_type = std::ptrdiff_t;
+                using pointer = const unsigned *;
+                using reference = unsigned;
+
+                iterator() : tree(nullptr), node(NONE) {}
+                iterator(const SyntaxTree *tree, unsigned node) : tree(tree), node(node) {}
+
+                inline unsigned operator * () const { return node; }
+                inline iterator &operator ++ () { node = tree->nodes[node].next_sibling; return *this; }
+                inline iterator operator ++ (int) { iterator previous = *this; ++*this; return previous; }
+                inline bool operator == (const iterator &other) const { return node == other.node; }
+            };
+
+            Children(const SyntaxTree *tree, unsigned first) : tree(tree), first(first) {}
+
+            inline iterator begin() const { return iterator(tree, first); }
+            inline iterator end() const { return iterator(tree, NONE); }
+        };
+
+    private:
+
+        std::shared_ptr<const CompiledGrammar> grammar;
+        Text input;
+        std::vector<Node> nodes;
+
+    public:
+
+        SyntaxTree();
+
+        // CONTRACT: <nodes> form a tree rooted in node 0 over <input>, by the rules of <grammar>
+        SyntaxTree(std::shared_ptr<const CompiledGrammar> grammar, Text input, std::vector<Node> nodes);
+
+        // true if the input was rejected
+        inline bool empty() const { return nodes.empty(); }
+        inline std::size_t size() const { return nodes.size(); }
+        inline unsigned getRoot() const { return 0; }
+        inline const Node &getNode(unsigned node) const { return nodes[node]; }
+
+        inline Nonterminal getFrom(unsigned node) const { return grammar->getFrom(nodes[node].rule); }
+        inline const Rule &getRule(unsigned node) const { return grammar->getRule(nodes[node].rule); }
+        inline Children getChildren(unsigned node) const { return Children(this, nodes[node].first_child); }
+
+        // the input <node> derived
+        inline Text getText(unsigned node) const { return input.subspan(nodes[node].begin, nodes[node].end - nodes[node].begin); }
+
+        // Visits the nodes in preorder without recursion: enter(node, depth) on every
+        // node, terminal(symbol, text, depth) on the terminal symbols of the node at
+        // <depth> with the input each one read, in the order of its rule between the
+        // visits of its children, and leave(node, depth) once all its symbols are done.
+        template<typename Visitor>
+        void visit(Visitor &visitor) const {
+            struct Frame {
+                unsigned node;
+                unsigned symbol;
+                unsigned position;
+                unsigned child;
+            };
+
+            if (empty()) {
+                return;
+            }
+
+            std::vector<Frame> stack{ { 0, 0, nodes[0].begin, nodes[0].first_child } };
+            visitor.enter(0u, 0u);
+
+            while (!stack.empty()) {
+                Frame &frame = stack.back();
+                const unsigned depth = stack.size() - 1;
+                const Rule &rule = getRule(frame.node);
+
+                if (frame.symbol == rule.size()) {
+                    visitor.leave(frame.node, depth);
+                    stack.pop_back();
+                    continue;
+                }
+
+                const Symbol &s = rule[frame.symbol++];
+                if (s.isTerminal) {
+                    const unsigned length = grammar->getLength(s);
+                    visitor.terminal(s, input.subspan(frame.position, length), depth);
+                    frame.position += length;
+                } else {
+                    const unsigned child = frame.child;
+                    frame.position = nodes[child].end;
+                    frame.child = nodes[child].next_sibling;
+                    visitor.enter(child, depth + 1);
+                    stack.push_back({ child, 0, nodes[child].begin, nodes[child].first_child });
+                }
+            }
+        }
+
+        // the tree in nested form, with the characters that classes matched in place of
+        // the classes, refined like the trees parseTree() returns if <refine>
+        ProductionTree toProductionTree(bool refine = true) const;
+    };
+
+} // namespace cfg
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Per-step events are only compiled in if the build defines CFG_TRACE_STEPS; otherwise
+// CFG_TRACE_STEP expands to nothing and its message is never evaluated.
+#ifdef CFG_TRACE_STEPS
+    #define CFG_TRACE_STEP(sink, message) \
+        do { if ((sink) && (sink)->enabled(::cfg::TraceLevel::STEP)) { (sink)->write(::cfg::TraceLevel::STEP, (message)); } } while (false)
+#else
+    #define CFG_TRACE_STEP(sink, message) do {} while (false)
+#endif
+
+namespace cfg {
+
+    enum class TraceLevel : unsigned {
+        GRAMMAR = 1 << 0,   // the grammar once it is loaded
+        TABLE   = 1 << 1,   // the parse table of every input
+        TREE    = 1 << 2,   // the parse tree of every input, before and after refinement
+        STEP    = 1 << 3,   // every item or table entry added (needs CFG_TRACE_STEPS)
+    };
+
+    inline unsigned operator | (TraceLevel a, TraceLevel b) { return static_cast<unsigned>(a) | static_cast<unsigned>(b); }
+    inline unsigned operator | (unsigned a, TraceLevel b) { return a | static_cast<unsigned>(b); }
+
+    // Destination of the diagnostics a parser produces. Parsers ask enabled() before
+    // formatting anything, so a disabled level costs a single call; without a sink
+    // nothing is formatted at all.
+    class TraceSink {
+
+    public:
+
+        virtual ~TraceSink() = default;
+
+        virtual bool enabled(TraceLevel level) const = 0;
+        virtual void write(TraceLevel level, const std::string &message) = 0;
+    };
+
+    // writes every enabled message to a stream, e.g. std::cout or a std::ofstream
+    class StreamTraceSink : public TraceSink {
+
+    private:
+
+        std::ostream &stream;
+        unsigned levels;
+        std::mutex mutex;
+
+    public:
+
+        StreamTraceSink(std::ostream &stream, unsigned levels);
+
+        virtual bool enabled(TraceLevel level) const;
+        virtual void write(TraceLevel level, const std::string &message);
+    };
+
+    // keeps the last <capacity> enabled messages in memory
+    class RingBufferTraceSink : public TraceSink {
+
+    private:
+
+        std::vector<std::string> buffer;
+        std::size_t next, count;
+        unsigned levels;
+        mutable std::mutex mutex;
+
+    public:
+
+        RingBufferTraceSink(std::size_t capacity, unsigned levels);
+
+        virtual bool enabled(TraceLevel level) const;
+        virtual void write(TraceLevel level, const std::string &message);
+
+        // the buffered messages, oldest first
+        std::vector<std::string> messages() const;
+    };
+
+} // namespace cfg
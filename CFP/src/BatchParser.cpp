@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "BatchParser.hpp"
+
+namespace cfg {
+
+    // inputs taken from the front of a share at once
+    static constexpr std::size_t GRAIN = 4;
+
+    // the inputs [begin, end) a thread has left; the owner takes them from the front,
+    // other threads steal from the back
+    struct Share {
+        std::mutex mutex;
+        std::size_t begin = 0, end = 0;
+    };
+
+    // moves the back half of the largest share left to share <thief>; returns false
+    // once every share is used up. Only one lock is held at a time, the chosen share
+    // may have shrunk by the time it is locked
+    static bool steal(std::vector<std::unique_ptr<Share>> &shares, unsigned thief) {
+        for (;;) {
+            unsigned victim = thief;
+            std::size_t largest = 0;
+            for (unsigned i = 0; i < shares.size(); i++) {
+                std::lock_guard<std::mutex> lock(shares[i]->mutex);
+                if (shares[i]->end - shares[i]->begin > largest) {
+                    largest = shares[i]->end - shares[i]->begin;
+                    victim = i;
+                }
+            }
+            if (largest == 0) {
+                return false;
+            }
+
+            std::size_t begin, end;
+            {
+                std::lock_guard<std::mutex> lock(shares[victim]->mutex);
+                const std::size_t left = shares[victim]->end - shares[victim]->begin;
+                if (left == 0) {
+                    continue;
+                }
+                end = shares[victim]->end;
+                begin = end - (left + 1) / 2;
+                shares[victim]->end = begin;
+            }
+
+            std::lock_guard<std::mutex> lock(shares[thief]->mutex);
+            shares[thief]->begin = begin;
+            shares[thief]->end = end;
+            return true;
+        }
+    }
+
+    std::vector<bool> parseBatch(const Parser &parser, const std::vector<String> &inputs, unsigned threads) {
+        // std::vector<bool> packs its elements into shared words, so every thread writes
+        // into a byte of its own
+        std::vector<char> accepted(inputs.size(), false);
+
+        threads = std::max(1u, std::min<unsigned>(threads, inputs.size()));
+        if (threads == 1) {
+            ParseWorkspace workspace;
+            for (std::size_t i = 0; i < inputs.size(); i++) {
+                accepted[i] = parser.parseInput(inputs[i], workspace);
+            }
+            return std::vector<bool>(accepted.begin(), accepted.end());
+        }
+
+        std::vector<std::unique_ptr<Share>> shares;
+        for (unsigned i = 0; i < threads; i++) {
+            shares.push_back(std::make_unique<Share>());
+            shares.back()->begin = inputs.size() * i / threads;
+            shares.back()->end = inputs.size() * (i + 1) / threads;
+        }
+
+        // every thread parses in a workspace of its own
+        auto work = [&] (unsigned self) {
+            ParseWorkspace workspace;
+            for (;;) {
+                std::size_t begin, end;
+                {
+                    std::lock_guard<std::mutex> lock(shares[self]->mutex);
+                    begin = shares[self]->begin;
+                    end = std::min(begin + GRAIN, shares[self]->end);
+                    shares[self]->begin = end;
+                }
+
+                if (begin == end) {
+                    if (!steal(shares, self)) {
+                        return;
+                    }
+                    continue;
+                }
+
+                for (std::size_t i = begin; i < end; i++) {
+                    accepted[i] = parser.parseInput(inputs[i], workspace);
+                }
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for (unsigned i = 1; i < threads; i++) {
+            pool.emplace_back(work, i);
+        }
+        work(0);
+        for (std::thread &thread : pool) {
+            thread.join();
+        }
+
+        return std::vector<bool>(accepted.begin(), accepted.end());
+    }
+
+} // namespace cfg
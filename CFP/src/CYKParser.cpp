@@ -1,24 +1,26 @@
 #include <array>
+#include <cstdint>
+#include <sstream>
+#include <string>
 #include <vector>
 
 #include "CYKParser.hpp"
-
-// temporary
-#include <iostream>
-#include <sstream>
+#include "GrammarImage.hpp"
 
 namespace cfg {
 
-    static std::string printDPTable(const std::vector<std::vector<std::vector<Nonterminal>>> &DP) {
+    // CONTRACT: <DP> holds the cells of a table for an input of length <n>
+    static std::string printDPTable(const std::vector<std::vector<Nonterminal>> &DP, unsigned n) {
         std::stringstream stream;
 
-        for (unsigned x = 0; x < DP.size(); x++) {
+        for (unsigned x = 0; x < n; x++) {
             for (unsigned y = 0; y <= x; y++) {
-                if (DP.at(x).at(y).empty()) {
+                const std::vector<Nonterminal> &cell = DP.at(std::size_t{ x } * (x + 1) / 2 + y);
+                if (cell.empty()) {
                     stream << "*\t";
                 } else {
-                    for (unsigned i = 0; i < DP.at(x).at(y).size(); i++) {
-                        stream << DP.at(x).at(y).at(i) << ',';
+                    for (unsigned i = 0; i < cell.size(); i++) {
+                        stream << cell.at(i) << ',';
                     }
                     stream << '\t';
                 }
@@ -31,36 +33,72 @@ namespace cfg {
     CYKParser::CYKParser() {}
 
     void CYKParser::initGrammar(const std::string &filename) {
-        gm.parseFromFile(filename);
-        gm = gm.toCNF();
+        if (GrammarImage::isImage(filename)) {
+            gm = GrammarImage(filename).getCNF();
+        } else {
+            gm.parseFromFile(filename);
+            gm = gm.toCNF();
+        }
 
-        std::cout << gm.debugInfo() << "\n\n";
+        terminal_rules.clear();
+        binary_rules.clear();
+        auto index = [] (std::vector<Nonterminal> &targets, Nonterminal from) {
+            if (!contains(targets, from)) {
+                targets.push_back(from);
+            }
+        };
+
+        // a rule with a character class counts as a rule for each of its characters
+        for (const auto &[from, rules] : gm.g) {
+            for (const Rule &r : rules) {
+                if (r.size() == 1 && r.front().isTerminal && r.front().cls == NO_CLASS) {
+                    index(terminal_rules[r.front().t], from);
+                } else if (r.size() == 1 && r.front().isTerminal) {
+                    const CharacterClass &set = gm.classes.at(r.front().cls);
+                    for (Terminal c = 0; c < CHARACTERS; c++) {
+                        if (set.test(c)) {
+                            index(terminal_rules[c], from);
+                        }
+                    }
+                } else if (r.size() == 2 && !r.front().isTerminal && !r.back().isTerminal) {
+                    index(binary_rules[(std::uint64_t{ r.front().n } << 32) | r.back().n], from);
+                }
+            }
+        }
+
+        if (trace && trace->enabled(TraceLevel::GRAMMAR)) {
+            trace->write(TraceLevel::GRAMMAR, gm.debugInfo());
+        }
     }
 
-    bool CYKParser::parseInput(const std::vector<Terminal> &input) {
+    bool CYKParser::parseInput(const std::vector<Terminal> &input, ParseWorkspace &workspace) const {
 
         if (input.empty()) {
             return contains(gm.g.at(S), Rule{});
         }
-        
-        std::vector<std::vector<std::vector<Nonterminal>>> DP;
 
-        unsigned n = input.size();
+        const unsigned n = input.size();
 
-        DP.resize(n);
-        for (unsigned i = 0; i < n; i++) {
-            DP.at(i).resize(i + 1);
+        // the cells of the table are cleared, not released, so they keep their capacity
+        std::vector<std::vector<Nonterminal>> &DP = workspace.cells;
+        const std::size_t cells = std::size_t{ n } * (n + 1) / 2;
+        if (DP.size() < cells) {
+            DP.resize(cells);
         }
+        for (std::size_t c = 0; c < cells; c++) {
+            DP[c].clear();
+        }
+        auto cell = [&DP] (unsigned x, unsigned y) -> std::vector<Nonterminal> & { return DP[std::size_t{ x } * (x + 1) / 2 + y]; };
 
         // initialize DP table
         for (unsigned i = 0; i < n; i++) {
-            for (auto &it : gm.g) {
-                for (const Rule &r : it.second) {
-                    if (r.size() == 1 && r.front() == Symbol{ true, { .t = input.at(i) } } &&
-                            !contains(DP.at(i).at(i), it.first)) {
-                        DP.at(i).at(i).push_back(it.first);
-                    }
-                }
+            const auto targets = terminal_rules.find(input.at(i));
+            if (targets == terminal_rules.end()) {
+                continue;
+            }
+            for (Nonterminal from : targets->second) {
+                cell(i, i).push_back(from);
+                CFG_TRACE_STEP(trace, "[" + std::to_string(i) + "/" + std::to_string(i) + "] " + std::to_string(from));
             }
         }
 
@@ -68,14 +106,18 @@ namespace cfg {
         for (unsigned i = 1; i < n; i++) {
             for (int j = i; j >= 0; j--) {
                 for (unsigned d = 1; d <= i - j; d++) {
-                    const std::vector<Nonterminal> &vi = DP.at(i - d).at(j), &vj = DP.at(i).at(i - d + 1);
+                    const std::vector<Nonterminal> &vi = cell(i - d, j), &vj = cell(i, i - d + 1);
 
                     for (const Nonterminal &na : vi) {
                         for (const Nonterminal &nb : vj) {
-                            for (const auto &it : gm.g) {
-                                Rule r = { Symbol{ false, { .n = na } }, Symbol{ false, { .n = nb } } };
-                                if (contains(it.second, r) && !contains(DP.at(i).at(j), it.first)) {
-                                    DP.at(i).at(j).push_back(it.first);
+                            const auto targets = binary_rules.find((std::uint64_t{ na } << 32) | nb);
+                            if (targets == binary_rules.end()) {
+                                continue;
+                            }
+                            for (Nonterminal from : targets->second) {
+                                if (!contains(cell(i, j), from)) {
+                                    cell(i, j).push_back(from);
+                                    CFG_TRACE_STEP(trace, "[" + std::to_string(i) + "/" + std::to_string(j) + "] " + std::to_string(from));
                                 }
                             }
                         }
@@ -84,9 +126,11 @@ namespace cfg {
             }
         }
 
-        std::cout << "\n\n" << printDPTable(DP) << "\n\n";
+        if (trace && trace->enabled(TraceLevel::TABLE)) {
+            trace->write(TraceLevel::TABLE, printDPTable(DP, n));
+        }
 
-        return contains(DP.at(n - 1).at(0), S);
+        return contains(cell(n - 1, 0), S);
     }
 
-} // namespace cfg
\ No newline at end of file
+} // namespace cfg
@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <queue>
+
+#include "CompiledGrammar.hpp"
+
+namespace cfg {
+
+    // adds the terminals terminal symbol <s> may start with to <set>
+    static void addTerminals(TerminalSet &set, const Symbol &s, const std::vector<TerminalSet> &class_sets) {
+        if (s.cls == NO_CLASS) {
+            set.set(s.t);
+        } else {
+            set |= class_sets[s.cls];
+        }
+    }
+
+    CompiledGrammar::CompiledGrammar(const GrammarManager &gm) : CompiledGrammar(gm, FixedPoints{}) {}
+
+    // without given sets, the fixed points start out empty and are computed here
+    CompiledGrammar::CompiledGrammar(const GrammarManager &gm, FixedPoints sets)
+        : rules(getRuleTable(gm.g)), alphabet(gm.token_maxindex), classes(gm.classes), class_sets(classes.size(), TerminalSet(alphabet)),
+          literals(gm.literals), window(1), nullable(std::move(sets.nullable)), first(std::move(sets.first)), follow(std::move(sets.follow)) {
+
+        for (unsigned cls = 0; cls < classes.size(); cls++) {
+            class_sets[cls].set(classes[cls]);
+        }
+        for (const String &literal : literals) {
+            window = std::max<unsigned>(window, literal.size());
+        }
+
+        const Nonterminal nonterminals = std::max<std::size_t>(rules.ranges.size(), gm.nonterminal_maxindex);
+        rules.ranges.resize(nonterminals, { 0, 0 });
+
+        root_rule = rules.rules.size();
+        rules.from.push_back(ROOT);
+        rules.rules.push_back({ { false, { .n = S } } });
+
+        const bool given = !nullable.empty();
+        nullable.resize(nonterminals, false);
+        first.resize(nonterminals, TerminalSet(alphabet));
+        follow.resize(nonterminals, TerminalSet(alphabet));
+        predictions.resize(nonterminals);
+        closures.resize(nonterminals);
+        null_trees.resize(nonterminals, { FAIL, Rule{}, std::vector<ProductionTree>{} });
+        null_rules.resize(nonterminals, root_rule);
+
+        if (!given) {
+            computeNullable();
+            computeFirst();
+        }
+        computeSuffixSets();
+        if (!given) {
+            computeFollow();
+        }
+        computeClosures();
+        computeNullTrees();
+        computeRefinement(gm);
+    }
+
+    // least fixed point: a nonterminal is nullable if one of its rules consists of
+    // nullable nonterminals only
+    void CompiledGrammar::computeNullable() {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (unsigned r = 0; r < root_rule; r++) {
+                const Nonterminal from = rules.from[r];
+                if (nullable[from]) {
+                    continue;
+                }
+
+                const Rule &rule = rules.rules[r];
+                if (std::all_of(rule.begin(), rule.end(), [this] (const Symbol &s) { return !s.isTerminal && nullable[s.n]; })) {
+                    nullable[from] = changed = true;
+                }
+            }
+        }
+    }
+
+    // least fixed point: FIRST(A) contains the first symbol of each rule of A, and the
+    // symbol following every nullable prefix of the rule
+    void CompiledGrammar::computeFirst() {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (unsigned r = 0; r < root_rule; r++) {
+                TerminalSet &set = first[rules.from[r]];
+                const TerminalSet before = set;
+
+                for (const Symbol &s : rules.rules[r]) {
+                    if (s.isTerminal) {
+                        addTerminals(set, s, class_sets);
+                        break;
+                    }
+                    set |= first[s.n];
+                    if (!nullable[s.n]) {
+                        break;
+                    }
+                }
+
+                changed |= set != before;
+            }
+        }
+    }
+
+    // walks every rule backwards: the rest of a rule behind its last symbol derives the
+    // empty word, every symbol in front of it adds its FIRST set while it is nullable
+    void CompiledGrammar::computeSuffixSets() {
+        item_offset.resize(rules.rules.size());
+
+        unsigned offset = 0;
+        for (unsigned r = 0; r < rules.rules.size(); r++) {
+            item_offset[r] = offset;
+            offset += rules.rules[r].size() + 1;
+        }
+        suffix_nullable.resize(offset, false);
+        suffix_first.resize(offset, TerminalSet(alphabet));
+
+        for (unsigned r = 0; r < rules.rules.size(); r++) {
+            const Rule &rule = rules.rules[r];
+            const unsigned base = item_offset[r];
+
+            suffix_nullable[base + rule.size()] = true;
+            for (unsigned dot = rule.size(); dot-- > 0;) {
+                if (rule[dot].isTerminal) {
+                    addTerminals(suffix_first[base + dot], rule[dot], class_sets);
+                } else {
+                    suffix_first[base + dot] = first[rule[dot].n];
+                    if (nullable[rule[dot].n]) {
+                        suffix_first[base + dot] |= suffix_first[base + dot + 1];
+                        suffix_nullable[base + dot] = suffix_nullable[base + dot + 1];
+                    }
+                }
+            }
+        }
+    }
+
+    // least fixed point: FOLLOW(B) contains FIRST of what follows B in any rule, and
+    // FOLLOW(A) if that can derive the empty word in a rule of A
+    void CompiledGrammar::computeFollow() {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (unsigned r = 0; r < root_rule; r++) {
+                const Rule &rule = rules.rules[r];
+                for (unsigned i = 0; i < rule.size(); i++) {
+                    if (rule[i].isTerminal) {
+                        continue;
+                    }
+
+                    TerminalSet &set = follow[rule[i].n];
+                    const TerminalSet before = set;
+
+                    set |= getSuffixFirst(r, i + 1);
+                    if (isNullableSuffix(r, i + 1)) {
+                        set |= follow[rules.from[r]];
+                    }
+
+                    changed |= set != before;
+                }
+            }
+        }
+    }
+
+    // The predictions of a nonterminal are its rules with the dot moved over every
+    // nullable prefix. Its closure collects the nonterminals after those dots
+    // breadth-first, starting with the nonterminal itself.
+    void CompiledGrammar::computeClosures() {
+        for (Nonterminal n = 0; n < predictions.size(); n++) {
+            const std::pair<unsigned, unsigned> range = rules.ranges[n];
+            for (unsigned r = range.first; r < range.second; r++) {
+                const Rule &rule = rules.rules[r];
+                for (unsigned dot = 0; ; dot++) {
+                    predictions[n].emplace_back(r, dot);
+                    if (dot == rule.size() || rule[dot].isTerminal || !nullable[rule[dot].n]) {
+                        break;
+                    }
+                }
+            }
+        }
+
+        std::vector<bool> reached(predictions.size(), false);
+        for (Nonterminal n = 0; n < closures.size(); n++) {
+            std::vector<Nonterminal> &closure = closures[n];
+
+            closure.push_back(n);
+            reached[n] = true;
+            for (unsigned i = 0; i < closure.size(); i++) {
+                for (const auto &[r, dot] : predictions[closure[i]]) {
+                    const Rule &rule = rules.rules[r];
+                    if (dot < rule.size() && !rule[dot].isTerminal && !reached[rule[dot].n]) {
+                        closure.push_back(rule[dot].n);
+                        reached[rule[dot].n] = true;
+                    }
+                }
+            }
+
+            for (Nonterminal m : closure) {
+                reached[m] = false;
+            }
+        }
+    }
+
+    // Knuth's generalization of Dijkstra's algorithm: every null tree has the fewest
+    // nodes of all derivations of the empty word from its nonterminal. A rule of
+    // nullable nonterminals only becomes a candidate once the trees of all its
+    // symbols are final; its size is one plus theirs. Candidates are settled in order
+    // of size, then rule, so the choice is deterministic and every tree is finite.
+    void CompiledGrammar::computeNullTrees() {
+        using Candidate = std::pair<std::size_t, unsigned>; // (size, rule)
+
+        std::vector<std::size_t> size(nullable.size(), 0);
+        std::vector<unsigned> unsettled(root_rule, 0);
+        std::vector<std::vector<unsigned>> occurrences(nullable.size());
+        std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+
+        for (unsigned r = 0; r < root_rule; r++) {
+            const Rule &rule = rules.rules[r];
+            if (!std::all_of(rule.begin(), rule.end(), [this] (const Symbol &s) { return !s.isTerminal && nullable[s.n]; })) {
+                continue;
+            }
+
+            for (const Symbol &s : rule) {
+                occurrences[s.n].push_back(r);
+            }
+            unsettled[r] = rule.size();
+            if (rule.empty()) {
+                candidates.emplace(1, r);
+            }
+        }
+
+        std::vector<bool> settled(nullable.size(), false);
+        while (!candidates.empty()) {
+            const auto [tree_size, r] = candidates.top();
+            const Nonterminal from = rules.from[r];
+            candidates.pop();
+
+            if (settled[from]) {
+                continue;
+            }
+            settled[from] = true;
+            size[from] = tree_size;
+
+            const Rule &rule = rules.rules[r];
+            ProductionTree tree = { from, rule, std::vector<ProductionTree>{} };
+            for (const Symbol &s : rule) {
+                tree.subtrees.push_back(null_trees[s.n]);
+            }
+            null_trees[from] = std::move(tree);
+            null_rules[from] = r;
+
+            for (unsigned user : occurrences[from]) {
+                if (--unsettled[user] == 0) {
+                    std::size_t total = 1;
+                    for (const Symbol &s : rules.rules[user]) {
+                        total += size[s.n];
+                    }
+                    candidates.emplace(total, user);
+                }
+            }
+        }
+    }
+
+    // the rules of the grammar are compared with its *> rules once here, so that a
+    // tree is refined by the rules of its nodes alone
+    void CompiledGrammar::computeRefinement(const GrammarManager &gm) {
+        full_resolve.resize(rules.rules.size(), false);
+        for (const auto &[from, resolved] : gm.fullresolveRules) {
+            const auto [first, last] = rules.ranges.at(from);
+            for (unsigned r = first; r < last; r++) {
+                full_resolve[r] = contains(resolved, rules.rules[r]);
+            }
+        }
+
+        omitted.resize(nullable.size(), 0);
+        for (const auto &it : gm.clearProductions) {
+            omitted.at(it.first) = CLEAR_RULE;
+        }
+        for (const auto &it : gm.deleteProductions) {
+            omitted.at(it.first) = DELETE_RULE;
+        }
+    }
+
+    // the subtrees are moved, not copied
+    void CompiledGrammar::refineNode(ProductionTree &tree, bool full_resolve) const {
+        if (!full_resolve && std::none_of(tree.rule.begin(), tree.rule.end(),
+                [this] (const Symbol &s) { return !s.isTerminal && isDeleted(s.n); })) {
+            return;
+        }
+
+        Rule rule;
+        std::vector<ProductionTree> subtrees;
+        unsigned subtree = 0;
+        for (const Symbol &s : tree.rule) {
+            if (s.isTerminal || subtree == tree.subtrees.size()) {
+                rule.push_back(s);
+                continue;
+            }
+
+            ProductionTree &child = tree.subtrees[subtree++];
+            if (full_resolve) {
+                rule.insert(rule.end(), child.rule.begin(), child.rule.end());
+                subtrees.insert(subtrees.end(), std::make_move_iterator(child.subtrees.begin()), std::make_move_iterator(child.subtrees.end()));
+            } else if (!isDeleted(s.n)) {
+                rule.push_back(s);
+                subtrees.push_back(std::move(child));
+            }
+        }
+
+        tree.rule = std::move(rule);
+        tree.subtrees = std::move(subtrees);
+    }
+
+} // namespace cfg
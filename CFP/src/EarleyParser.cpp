@@ -1,200 +1,399 @@
 #include <algorithm>
+#include <bit>
 #include <climits>
-#include <functional>
-#include <map>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
-#include "EarleyParser.hpp"
-
-// temporary
 #include <iomanip>
-#include <iostream>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <tuple>
 
-namespace cfg {
+#include "EarleyParser.hpp"
+#include "GrammarImage.hpp"
 
-    template<typename T>
-    static std::vector<T> operator + (const std::vector<T> &left, const T &right) {
-        std::vector<T> result = left;
-        result.push_back(right);
-        return result;
-    }
+namespace cfg {
 
-    template<typename T>
-    static std::vector<T> operator + (const std::vector<T> &left, const std::vector<T> &right) {
-        std::vector<T> result = left;
-        result.insert(result.end(), right.begin(), right.end());
-        return result;
-    }
+    static constexpr unsigned NO_ALTERNATIVE = UINT_MAX;
 
+    // an Earley item is the dotted rule <rule> of the rule table with the dot before
+    // symbol <dot>, started at column <start>; the symbols before and after the dot
+    // are read from the rule table whenever they are needed. Further derivations of
+    // the same item are chained through <alternative> in the column's alternatives.
+    // A NULL_PREFIX item was predicted with its dot already behind a prefix of
+    // nullable nonterminals, which all derive the empty word
     struct EarleyItem {
         unsigned start;
-        Nonterminal from;
-        Symbols pre, post;
+        unsigned rule, dot;
 
-        enum class DerivationType { ROOT, SCAN, NULLABLE_SCAN, PREDICT, COMPLETE } type;
+        enum class DerivationType { ROOT, SCAN, NULLABLE_SCAN, PREDICT, NULL_PREFIX, COMPLETE, LEO } type;
         std::pair<std::pair<unsigned, unsigned>, std::pair<unsigned, unsigned>> backpointer;
 
+        unsigned alternative = NO_ALTERNATIVE;
+
         inline bool operator == (const EarleyItem &i) const {
-            return start == i.start && from == i.from && pre == i.pre && post == i.post; // ignore antecedent pointers
+            return start == i.start && rule == i.rule && dot == i.dot; // ignore antecedent pointers
         }
+    };
+
+    // returns the symbol after the dot, or nullptr if the item is complete
+    static inline const Symbol *nextSymbol(const CompiledGrammar &cg, const EarleyItem &item) {
+        const Rule &rule = cg.getRule(item.rule);
+        return item.dot < rule.size() ? &rule[item.dot] : nullptr;
+    }
+
+    static inline EarleyItem advance(const EarleyItem &item, EarleyItem::DerivationType type,
+            std::pair<std::pair<unsigned, unsigned>, std::pair<unsigned, unsigned>> backpointer) {
+        return { item.start, item.rule, item.dot + 1, type, backpointer };
+    }
+
+    // a character as itself, a token as @ and its id
+    static std::string terminalToString(Terminal t) {
+        return t < CHARACTERS ? std::string(1, char(t)) : "@" + std::to_string(t);
+    }
+
+    static std::string itemToString(const CompiledGrammar &cg, const EarleyItem &item) {
+        std::stringstream stream;
+
+        const Nonterminal from = cg.getFrom(item.rule);
+        const Rule &rule = cg.getRule(item.rule);
 
-        inline operator std::string() const {
-            std::stringstream stream;
+        stream << "[ @" << item.start << "-? : <";
+        if (from == ROOT) {
+            stream << "^";
+        } else {
+            stream << from;
+        }
+        stream << "> -> ";
 
-            stream << "[ @" << start << "-? : <";
-            if (from == ROOT) {
-                stream << "^";
+        for (unsigned i = 0; i < rule.size(); i++) {
+            if (i == item.dot) {
+                stream << " * ";
+            }
+            if (rule.at(i).isTerminal && rule.at(i).cls != NO_CLASS) {
+                stream << classToString(cg.getClass(rule.at(i).cls));
+            } else if (rule.at(i).isTerminal && rule.at(i).literal != NO_LITERAL) {
+                for (Terminal t : cg.getLiteral(rule.at(i).literal)) {
+                    stream << terminalToString(t);
+                }
+            } else if (rule.at(i).isTerminal) {
+                stream << terminalToString(rule.at(i).t);
             } else {
-                stream << from;
+                stream << "<" << rule.at(i).n << ">";
             }
-            stream << "> -> ";
+        }
+        if (item.dot == rule.size()) {
+            stream << " * ";
+        }
+        stream << " : ";
+        if (item.type != EarleyItem::DerivationType::COMPLETE && item.type != EarleyItem::DerivationType::LEO) {
+            stream << "(" << item.backpointer.first.first << "/" << item.backpointer.first.second << ")";
+        } else {
+            stream << "{(" << item.backpointer.first.first << "/" << item.backpointer.first.second << ")," <<
+                    item.backpointer.second.first << "/" << item.backpointer.second.second << ")}";
+        }
+        stream << " ]";
+        return stream.str();
+    }
 
-            for (const Symbol &s : pre) {
-                if (s.isTerminal) {
-                    stream << s.t;
-                } else {
-                    stream << "<" << s.n << ">";
+    struct EarleyItemHash {
+        inline std::size_t operator () (const EarleyItem &i) const {
+            std::size_t h = i.start;
+            auto combine = [&h] (std::size_t v) { h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2); };
+
+            combine(i.rule);
+            combine(i.dot);
+            return h;
+        }
+    };
+
+    // Leo's transitive item for nonterminal A in column j. If column j holds exactly one
+    // item waiting for A, and A is the last symbol of its rule (row <parent>), completing
+    // any A started in j completes the parent as well. If the parent's own completion is
+    // deterministic in the same way, the path goes on; <top> is the position of the item
+    // at its upper end, the only one that needs to be advanced and added to the table.
+    struct LeoItem {
+        bool deterministic;
+        unsigned parent;
+        std::pair<unsigned, unsigned> top;
+    };
+
+    // one column of the Earley table: the items in insertion order, a hash index over
+    // the item identities (start, rule, dot position) for constant-time deduplication,
+    // the derivations of items found after the first one, for every nonterminal the
+    // rows of the items waiting for it after their dot, and the memoized Leo items of
+    // the column
+    struct Column {
+        std::vector<EarleyItem> items;
+        std::unordered_multimap<std::size_t, unsigned> index;
+        std::vector<EarleyItem> alternatives;
+        std::unordered_map<Nonterminal, std::vector<unsigned>> waiting;
+        std::unordered_map<Nonterminal, LeoItem> leo;
+
+        inline std::size_t size() const { return items.size(); }
+        inline EarleyItem &at(unsigned row) { return items.at(row); }
+        inline const EarleyItem &at(unsigned row) const { return items.at(row); }
+
+        // returns the item equal to <item>, or nullptr if it is not in the column
+        const EarleyItem *find(const EarleyItem &item) const {
+            auto range = index.equal_range(EarleyItemHash{}(item));
+            for (auto it = range.first; it != range.second; it++) {
+                if (items.at(it->second) == item) {
+                    return &items.at(it->second);
                 }
             }
-            stream << " * ";
-            for (const Symbol &s : post) {
-                if (s.isTerminal) {
-                    stream << s.t;
-                } else {
-                    stream << "<" << s.n << ">";
+            return nullptr;
+        }
+
+        // appends the item unless an equal item is already in the column; a new
+        // derivation of a known item is kept as one of its alternatives (predictions
+        // have no derivation worth keeping)
+        bool add(const CompiledGrammar &cg, const EarleyItem &item) {
+            const std::size_t hash = EarleyItemHash{}(item);
+
+            auto range = index.equal_range(hash);
+            for (auto it = range.first; it != range.second; it++) {
+                EarleyItem &known = items.at(it->second);
+                if (known == item) {
+                    if (item.type != EarleyItem::DerivationType::PREDICT && item.type != EarleyItem::DerivationType::ROOT) {
+                        alternatives.push_back(item);
+                        alternatives.back().alternative = known.alternative;
+                        known.alternative = alternatives.size() - 1;
+                    }
+                    return false;
                 }
             }
-            stream << " : ";
-            if (type != DerivationType::COMPLETE) {
-                stream << "(" << backpointer.first.first << "/" << backpointer.first.second << ")";
-            } else {
-                stream << "{(" << backpointer.first.first << "/" << backpointer.first.second << ")," <<
-                        backpointer.second.first << "/" << backpointer.second.second << ")}";
+
+            append(cg, item, hash);
+            return true;
+        }
+
+        // CONTRACT: no item equal to <item> is in the column
+        void append(const CompiledGrammar &cg, const EarleyItem &item, std::size_t hash) {
+            const Symbol *next = nextSymbol(cg, item);
+            if (next && !next->isTerminal) {
+                waiting[next->n].push_back(items.size());
             }
-            stream << " ]";
-            return stream.str();
+
+            index.emplace(hash, items.size());
+            items.push_back(item);
         }
     };
 
-    static std::map<Nonterminal, bool> getNullableRules(const Grammar &g) {
-        std::map<Nonterminal, bool> res, called, known;
-        for (const auto &u : g) {
-            res[u.first] = false;
-            called[u.first] = false;
-            known[u.first] = false;
-        }
+    using Table = std::vector<Column>;
 
-        std::function<bool(Nonterminal)> step = [&] (Nonterminal n) -> bool {
-            if (called.at(n)) { return false; }
-            if (known.at(n)) { return res.at(n); }
+    // the nonterminals the predictor already expanded in the column being processed;
+    // reset() only clears the bits that were set, so moving to the next column costs
+    // O(predictions) instead of O(nonterminals)
+    struct PredictionSet {
+        std::vector<bool> predicted;
+        std::vector<Nonterminal> expanded;
 
-            called.at(n) = true;
+        PredictionSet(Nonterminal nonterminals) : predicted(nonterminals, false) {}
 
-            for (const Rule &r : g.at(n)) {
-                if (std::find_if(r.begin(), r.end(), [&] (Symbol s) -> bool { return s.isTerminal || !step(s.n); }) == r.end()) {
-                    res.at(n) = true;
-                    break;
-                }
+        inline bool contains(Nonterminal n) const {
+            return predicted[n];
+        }
+
+        // returns false if <n> was already predicted in this column
+        inline bool insert(Nonterminal n) {
+            if (predicted[n]) {
+                return false;
             }
+            predicted[n] = true;
+            expanded.push_back(n);
+            return true;
+        }
 
-            called.at(n) = false;
-            known.at(n) = true;
-            return res.at(n);
-        };
+        inline void reset() {
+            for (Nonterminal n : expanded) {
+                predicted[n] = false;
+            }
+            expanded.clear();
+        }
+    };
+
+    static bool predict(const CompiledGrammar &cg, const String &input, Table &DP, unsigned col, unsigned row, PredictionSet &predicted);
+    static bool scan(const CompiledGrammar &cg, const String &input, Table &DP, unsigned col, unsigned row);
+    static void scanExtra(const CompiledGrammar &cg, const String &input, Table &DP, unsigned col, unsigned row);
+    static bool complete(const CompiledGrammar &cg, const String &input, Table &DP, unsigned col, unsigned row);
+    static void removeDuplicates(Table &DP, const unsigned col) {}
 
-        for (const auto &u : g) {
-            step(u.first);
+    // a dotted rule can only take part in a parse from column <col> if the rest of the
+    // rule starts with the next character, or if it derives the empty word and the
+    // character may follow the rule's nonterminal; at the end of the input only the
+    // latter are left
+    static inline bool matchesLookahead(const CompiledGrammar &cg, unsigned rule, unsigned dot, const Terminal *lookahead) {
+        if (!lookahead) {
+            return cg.isNullableSuffix(rule, dot);
         }
 
-        return res;
+        const Terminal t = *lookahead;
+        return contains(cg.getSuffixFirst(rule, dot), t) || (cg.isNullableSuffix(rule, dot) && contains(cg.getFollow(cg.getFrom(rule)), t));
     }
 
-    using Table = std::vector<std::vector<EarleyItem>>;
-
-    static bool predict(const Grammar &g, const String &input, Table &DP, unsigned col, unsigned row);
-    static bool scan(const Grammar &g, const String &input, Table &DP, unsigned col, unsigned row);
-    static void scanExtra(const Grammar &g, const String &input, Table &DP, unsigned col, unsigned row, const std::map<Nonterminal, bool> &nullable_map);
-    static bool complete(const Grammar &g, const String &input, Table &DP, unsigned col, unsigned row);
-    static void removeDuplicates(Table &DP, const unsigned col) {}
+    static inline bool matchesLookahead(const CompiledGrammar &cg, unsigned rule, unsigned dot, const String &input, unsigned col) {
+        return matchesLookahead(cg, rule, dot, col == input.size() ? nullptr : &input[col]);
+    }
 
-    static bool predict(const Grammar &g, const String &input, Table &DP, unsigned col, unsigned row) {
-        const EarleyItem entry = DP.at(col).at(row);
+    static bool predict(const CompiledGrammar &cg, const String &input, Table &DP, unsigned col, unsigned row, PredictionSet &predicted) {
+        const Symbol *next = nextSymbol(cg, DP.at(col).at(row));
 
         // do not predict an item that doesn't start with a nonterminal
-        if (entry.post.empty() || entry.post.front().isTerminal) {
+        if (!next || next->isTerminal) {
             return false;
         }
 
         // do not predict an item that has already been predicted
-        for (unsigned i = 0; i < row; i++) {
-            if (!DP.at(col).at(i).post.empty() && DP.at(col).at(i).post.front() == entry.post.front()) {
-                return false;
-            }
+        if (predicted.contains(next->n)) {
+            return false;
         }
 
-        // predict all production rules from the item
-        for (const Rule &r : g.at(entry.post.front().n)) {
-            EarleyItem next_item = { col, entry.post.front().n, {}, r, EarleyItem::DerivationType::PREDICT, { { col, row }, { 0, 0 } } };
-            if (!contains(DP.at(col), next_item)) {
-                DP.at(col).push_back(next_item);
+        // add the precomputed closure in one go: the rules of every nonterminal it
+        // reaches that was not predicted in this column yet, with the dot at their
+        // beginning or behind a nullable prefix, as far as they fit the lookahead.
+        // Items started in this column only exist once their nonterminal is
+        // predicted, so these are all new
+        for (Nonterminal n : cg.getClosure(next->n)) {
+            if (!predicted.insert(n)) {
+                continue;
+            }
+            for (const auto &[rule, dot] : cg.getPredictions(n)) {
+                if (!matchesLookahead(cg, rule, dot, input, col)) {
+                    continue;
+                }
+                const EarleyItem::DerivationType type = dot == 0 ? EarleyItem::DerivationType::PREDICT : EarleyItem::DerivationType::NULL_PREFIX;
+                const EarleyItem item = { col, rule, dot, type, { { col, row }, { 0, 0 } } };
+                DP.at(col).append(cg, item, EarleyItemHash{}(item));
             }
         }
         return true;
     }
 
-    static bool scan(const Grammar &g, const String &input, Table &DP, unsigned col, unsigned row) {
+    static bool scan(const CompiledGrammar &cg, const String &input, Table &DP, unsigned col, unsigned row) {
         const EarleyItem &entry = DP.at(col).at(row);
+        const Symbol *next = nextSymbol(cg, entry);
 
         // do not scan at the end of the input, a fully parsed item or a nonterminal
-        if (col == input.size() || entry.post.empty() || !entry.post.front().isTerminal) {
+        if (col == input.size() || !next || !next->isTerminal) {
             return false;
         }
 
-        if (input.at(col) == entry.post.front().t) {
-            EarleyItem next_item = { entry.start, entry.from, entry.pre + entry.post.front(), Symbols(entry.post.begin() + 1, entry.post.end()), EarleyItem::DerivationType::SCAN, { { col, row }, { 0, 0 } } };
-            if (!contains(DP.at(col + 1), next_item)) {
-                DP.at(col + 1).push_back(next_item);
-            }
+        // a literal moves the dot over all of its terminals, into the column behind them
+        if (cg.scans(*next, &input[col], input.size() - col)) {
+            DP.at(col + cg.getLength(*next)).add(cg, advance(entry, EarleyItem::DerivationType::SCAN, { { col, row }, { 0, 0 } }));
             return true;
         }
 
         return false;
     }
 
-    static void scanExtra(const Grammar &g, const String &input, Table &DP, unsigned col, unsigned row, const std::map<Nonterminal, bool> &nullable_map) {
+    static void scanExtra(const CompiledGrammar &cg, const String &input, Table &DP, unsigned col, unsigned row) {
         const EarleyItem entry = DP.at(col).at(row);
+        const Symbol *next = nextSymbol(cg, entry);
+
+        // the prediction closure already moved the dot of predicted items over their
+        // nullable prefixes
+        if (entry.type == EarleyItem::DerivationType::PREDICT || entry.type == EarleyItem::DerivationType::NULL_PREFIX) {
+            return;
+        }
+
+        if (next && !next->isTerminal && cg.isNullable(next->n)) {
+            DP.at(col).add(cg, advance(entry, EarleyItem::DerivationType::NULLABLE_SCAN, { { col, row }, { 0, 0 } }));
+        }
+    }
+
+    // a reduction path continues above <item> (found in column <col>) if its origin
+    // holds a deterministic Leo item for its nonterminal, whose parent row is stored in
+    // <parent>; requiring the origin to lie strictly before the column keeps the paths
+    // acyclic. This is decided on the waiting items of the origin rather than on its
+    // memoized Leo items, which columns rebuilt after an edit may lack.
+    static bool leoAbove(const CompiledGrammar &cg, const Table &DP, const EarleyItem &item, unsigned col, unsigned &parent) {
+        if (item.start == col) {
+            return false;
+        }
+
+        const Column &origin = DP.at(item.start);
+        const auto parents = origin.waiting.find(cg.getFrom(item.rule));
+        if (parents == origin.waiting.end() || parents->second.size() != 1) {
+            return false;
+        }
+
+        parent = parents->second.front();
+        const EarleyItem &waiting = origin.at(parent);
+        return waiting.dot + 1 == cg.getRule(waiting.rule).size();
+    }
+
+    // CONTRACT: column <col> is complete, no more items will be added to it
+    static const LeoItem &getLeoItem(const CompiledGrammar &cg, Table &DP, unsigned col, Nonterminal n) {
+        const auto known = DP.at(col).leo.find(n);
+        if (known != DP.at(col).leo.end()) {
+            return known->second;
+        }
+
+        LeoItem result = { false, 0, { 0, 0 } };
+
+        const auto parents = DP.at(col).waiting.find(n);
+        if (parents != DP.at(col).waiting.end() && parents->second.size() == 1) {
+            const unsigned parent_row = parents->second.front();
+            const EarleyItem &parent = DP.at(col).at(parent_row);
+
+            if (parent.dot + 1 == cg.getRule(parent.rule).size()) {
+                result = { true, parent_row, { col, parent_row } };
 
-        if (!entry.post.empty() && !entry.post.front().isTerminal && nullable_map.at(entry.post.front().n)) {
-            EarleyItem next_item = { entry.start, entry.from, entry.pre + entry.post.front(), Symbols(entry.post.begin() + 1, entry.post.end()), EarleyItem::DerivationType::NULLABLE_SCAN, { { col, row }, { 0, 0 } } };
-            if (!contains(DP.at(col), next_item)) {
-                DP.at(col).push_back(next_item);
+                if (parent.start < col && cg.getFrom(parent.rule) != ROOT) {
+                    const LeoItem &above = getLeoItem(cg, DP, parent.start, cg.getFrom(parent.rule));
+                    if (above.deterministic) {
+                        result.top = above.top;
+                    }
+                }
             }
         }
+
+        return DP.at(col).leo[n] = result;
     }
 
-    static bool complete(const Grammar &g, const String &input, Table &DP, unsigned col, unsigned row) {
+    static bool complete(const CompiledGrammar &cg, const String &input, Table &DP, unsigned col, unsigned row) {
         const EarleyItem entry = DP.at(col).at(row);
 
-        if (!entry.post.empty()) {
+        if (nextSymbol(cg, entry)) {
             return false;
         }
 
-        for (unsigned i = 0; i < DP.at(entry.start).size(); i++) {
-            const EarleyItem &before_entry = DP.at(entry.start).at(i);
-            if (!before_entry.post.empty() && before_entry.post.front() == Symbol{ false, { .n = entry.from } }) {
-                EarleyItem next_item = { before_entry.start, before_entry.from, before_entry.pre + before_entry.post.front(), Symbols(before_entry.post.begin() + 1, before_entry.post.end()), EarleyItem::DerivationType::COMPLETE, { { entry.start, i }, { col, row } } };
-                if (!contains(DP.at(col), next_item)) {
-                    DP.at(col).push_back(next_item);
-                }
-            } 
+        // on a deterministic reduction path only its topmost item is added
+        if (entry.start < col) {
+            const LeoItem &leo = getLeoItem(cg, DP, entry.start, cg.getFrom(entry.rule));
+            if (leo.deterministic) {
+                const EarleyItem top = DP.at(leo.top.first).at(leo.top.second);
+                DP.at(col).add(cg, advance(top, EarleyItem::DerivationType::LEO, { { entry.start, leo.parent }, { col, row } }));
+                return true;
+            }
+        }
+
+        // only visit the items waiting for the completed nonterminal; the list can grow
+        // while iterating if the completed item is empty and started in this column.
+        // Adding to that column may rehash its map, which invalidates the iterator but
+        // not the list itself, so the list is held by reference and indexed
+        const auto parents = DP.at(entry.start).waiting.find(cg.getFrom(entry.rule));
+        if (parents == DP.at(entry.start).waiting.end()) {
+            return true;
+        }
+
+        const std::vector<unsigned> &rows = parents->second;
+        for (unsigned i = 0; i < rows.size(); i++) {
+            const unsigned parent_row = rows.at(i);
+            const EarleyItem before_entry = DP.at(entry.start).at(parent_row);
+            DP.at(col).add(cg, advance(before_entry, EarleyItem::DerivationType::COMPLETE, { { entry.start, parent_row }, { col, row } }));
         }
 
         return true;
     }
 
-    static std::string printTable(const Table &DP, const std::vector<Terminal> &input) {
+    static std::string printTable(const CompiledGrammar &cg, const Table &DP, const std::vector<Terminal> &input) {
         static constexpr unsigned LEN = 70;
 
         std::stringstream stream;
@@ -206,14 +405,14 @@ namespace cfg {
 
         stream << "|";
         for (unsigned col = 0; col < DP.size(); col++) {
-            stream << std::setw(LEN) << (col == DP.size() - 1 ? ' ' : input.at(col)) << "|";
+            stream << std::setw(LEN) << (col == DP.size() - 1 ? " " : terminalToString(input.at(col))) << "|";
         }
         stream << "\n\n";
         for (unsigned row = 0; row < max; row++) {
             stream << "|";
             for (unsigned col = 0; col < DP.size(); col++) {
                 if (row < DP.at(col).size()) {
-                    stream << std::setw(LEN) << static_cast<std::string>(DP.at(col).at(row));
+                    stream << std::setw(LEN) << itemToString(cg, DP.at(col).at(row));
                 } else {
                     stream << std::setw(LEN) << ' ';
                 }
@@ -225,69 +424,318 @@ namespace cfg {
         return stream.str();
     }
 
-    // CONTRACT: This function assumes that <n> is nullable, otherwise unpredictable behavior
-    static ProductionTree getNullTree(const Grammar &g, const Nonterminal n) {
-        static std::map<Nonterminal, bool> called, known;
-        static std::map<Nonterminal, std::pair<bool, ProductionTree>> nullTrees;
+    // Parse tree of one parse, built in a single vector and released with it. The
+    // children of a node are linked through <first_child> and <next_sibling>; a node
+    // for the empty word of a nullable nonterminal has rule NULLED and no children,
+    // it stands for the grammar's null tree. Every node covers the input [begin, end).
+    struct TreeArena {
+        static constexpr unsigned NONE = SyntaxTree::NONE;
+        static constexpr unsigned NULLED = UINT_MAX;
+
+        struct Node {
+            Nonterminal from;
+            unsigned rule;
+            unsigned begin, end;
+            unsigned first_child, next_sibling;
+        };
+
+        std::vector<Node> nodes;
+
+        inline unsigned add(Nonterminal from, unsigned rule, unsigned begin, unsigned end) {
+            nodes.push_back({ from, rule, begin, end, NONE, NONE });
+            return nodes.size() - 1;
+        }
 
-        for (const auto &it : g) {
-            called[it.first] = false;
-            known[it.first] = false;
-            nullTrees[it.first] = { false, FAILED_PARSE };
+        // the symbols of a rule are walked from the end, so children are prepended
+        inline void prepend(unsigned parent, unsigned child) {
+            nodes[child].next_sibling = nodes[parent].first_child;
+            nodes[parent].first_child = child;
         }
+    };
 
-        static const std::function<std::pair<bool, ProductionTree>(Nonterminal)> step = [&] (Nonterminal n) -> std::pair<bool, ProductionTree> {
-            if (known.at(n)) { return nullTrees.at(n); }
-            if (called.at(n)) { return { false, FAILED_PARSE }; }
+    // Builds the tree of <target> without recursion: every frame of the work stack is
+    // a node whose rule is walked from the dot to its beginning along the backpointers;
+    // a completed child gets a node of its own and a frame on top of the stack.
+    // <target> is complete in column <end>.
+    static void backtrack(const CompiledGrammar &cg, const Table &DP, const EarleyItem &target, unsigned end, TreeArena &arena) {
+        struct Frame {
+            unsigned node;
+            const EarleyItem *item;
+        };
 
-            called.at(n) = true;
+        std::vector<Frame> stack;
+        stack.push_back({ arena.add(cg.getFrom(target.rule), target.rule, target.start, end), &target });
 
-            for (const Rule &r : g.at(n)) {
-                std::pair<bool, ProductionTree> tmpres = { true, { n, r, {} } };
-                for (const Symbol &s : r) {
-                    if (s.isTerminal) {
-                        tmpres.first = false;
-                        break;
-                    } else {
-                        std::pair<bool, ProductionTree> subtree = step(s.n);
-                        if (!subtree.first) {
-                            tmpres.first = false;
-                            break;
-                        } else {
-                            tmpres.second.subtrees.push_back(subtree.second);
+        while (!stack.empty()) {
+            const Frame frame = stack.back();
+            const EarleyItem *current_item = frame.item;
+
+            if (current_item->dot == 0) {
+                stack.pop_back();
+                continue;
+            }
+
+            const auto &backpointer = current_item->backpointer;
+            const EarleyItem *predecessor = &DP.at(backpointer.first.first).at(backpointer.first.second);
+
+            switch (current_item->type) {
+                case EarleyItem::DerivationType::SCAN:
+                    stack.back().item = predecessor;
+                    break;
+                case EarleyItem::DerivationType::NULLABLE_SCAN:
+                    {
+                        const unsigned position = backpointer.first.first;
+                        arena.prepend(frame.node, arena.add(cg.getRule(current_item->rule).at(current_item->dot - 1).n, TreeArena::NULLED, position, position));
+                        stack.back().item = predecessor;
+                    }
+                    break;
+                case EarleyItem::DerivationType::NULL_PREFIX:
+                    for (unsigned i = current_item->dot; i-- > 0;) {
+                        const unsigned position = current_item->start;
+                        arena.prepend(frame.node, arena.add(cg.getRule(current_item->rule).at(i).n, TreeArena::NULLED, position, position));
+                    }
+                    stack.pop_back();
+                    break;
+                case EarleyItem::DerivationType::COMPLETE:
+                    {
+                        const EarleyItem &child = DP.at(backpointer.second.first).at(backpointer.second.second);
+                        const unsigned node = arena.add(cg.getFrom(child.rule), child.rule, child.start, backpointer.second.first);
+                        arena.prepend(frame.node, node);
+                        stack.back().item = predecessor;
+                        stack.push_back({ node, &child });
+                    }
+                    break;
+                case EarleyItem::DerivationType::LEO:
+                    {
+                        // rebuild the completed items skipped on the reduction path, bottom-up,
+                        // until reaching the parent of the topmost one; all of them end where
+                        // the child does
+                        const std::size_t frame_index = stack.size() - 1;
+                        const unsigned end = backpointer.second.first;
+                        const EarleyItem &child = DP.at(end).at(backpointer.second.second);
+                        unsigned subtree = arena.add(cg.getFrom(child.rule), child.rule, child.start, end);
+                        stack.push_back({ subtree, &child });
+
+                        std::pair<unsigned, unsigned> position = backpointer.first;
+                        for (;;) {
+                            const EarleyItem &parent = DP.at(position.first).at(position.second);
+                            unsigned above;
+                            if (!leoAbove(cg, DP, parent, position.first, above)) {
+                                arena.prepend(frame.node, subtree);
+                                stack.at(frame_index).item = &parent;
+                                break;
+                            }
+
+                            const unsigned completed = arena.add(cg.getFrom(parent.rule), parent.rule, parent.start, end);
+                            arena.prepend(completed, subtree);
+                            stack.push_back({ completed, &parent });
+
+                            subtree = completed;
+                            position = { parent.start, above };
                         }
                     }
-                }
-                if (tmpres.first) {
-                    nullTrees.at(n) = tmpres;
                     break;
-                }
+                case EarleyItem::DerivationType::ROOT:    // never reached
+                case EarleyItem::DerivationType::PREDICT: // never reached
+                    break;
             }
+        }
+    }
 
-            known.at(n) = true;
-            called.at(n) = false;
-            return nullTrees.at(n);
-        };
+    // the nodes of the arena as the nodes of a syntax tree, in the same places, with
+    // the null tree of every nulled node spelled out behind them
+    static std::vector<SyntaxTree::Node> toSyntaxNodes(const CompiledGrammar &cg, const TreeArena &arena) {
+        std::vector<SyntaxTree::Node> nodes;
+        nodes.reserve(arena.nodes.size());
+
+        std::vector<unsigned> nulled;
+        for (const TreeArena::Node &node : arena.nodes) {
+            if (node.rule == TreeArena::NULLED) {
+                nulled.push_back(nodes.size());
+                nodes.push_back({ cg.getNullRule(node.from), node.begin, node.end, SyntaxTree::NONE, node.next_sibling });
+            } else {
+                nodes.push_back({ node.rule, node.begin, node.end, node.first_child, node.next_sibling });
+            }
+        }
+
+        while (!nulled.empty()) {
+            const unsigned node = nulled.back();
+            nulled.pop_back();
+
+            const Rule &rule = cg.getRule(nodes[node].rule);
+            const unsigned position = nodes[node].begin;
+            for (unsigned i = rule.size(); i-- > 0;) {
+                nodes.push_back({ cg.getNullRule(rule[i].n), position, position, SyntaxTree::NONE, nodes[node].first_child });
+                nodes[node].first_child = nodes.size() - 1;
+                nulled.push_back(nodes.size() - 1);
+            }
+        }
 
-        return step(n).second;
+        return nodes;
     }
 
-    static ProductionTree backtrack(const Grammar &g, const Table &DP, const EarleyItem &target) {
-        ProductionTree result{ target.from, target.pre + target.post, std::vector<ProductionTree>{} };
-        const EarleyItem *current_item = &target;
+    struct ForestKey {
+        ParseForest::NodeType type;
+        unsigned id, dot;
+        unsigned start, end;
 
-        while (!current_item->pre.empty()) {
-            switch (current_item->type) {
+        inline bool operator == (const ForestKey &k) const {
+            return type == k.type && id == k.id && dot == k.dot && start == k.start && end == k.end;
+        }
+    };
+
+    struct ForestKeyHash {
+        inline std::size_t operator () (const ForestKey &k) const {
+            std::size_t h = static_cast<std::size_t>(k.type);
+            auto combine = [&h] (std::size_t v) { h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2); };
+
+            combine(k.id);
+            combine(k.dot);
+            combine(k.start);
+            combine(k.end);
+            return h;
+        }
+    };
+
+    // Builds the SPPF of a finished table top-down from the root item. Item nodes take
+    // their packed nodes from the derivations recorded for the item, symbol nodes from
+    // the complete items of the nonterminal over their span. The completed items a Leo
+    // derivation skipped are not in the table; they become item nodes of their own
+    // while the reduction path is walked, and join the symbol nodes of their spans.
+    class ForestBuilder {
+
+    private:
+
+        const CompiledGrammar &cg;
+        const Table &DP;
+        const String &input;
+
+        std::vector<ParseForest::Node> nodes;
+        std::unordered_map<ForestKey, unsigned, ForestKeyHash> index;
+        std::vector<unsigned> pending;
+
+        // per column, the rows of the complete items by (nonterminal, start)
+        std::vector<std::unordered_map<std::uint64_t, std::vector<unsigned>>> completed;
+        std::vector<bool> completed_indexed;
+
+    private:
+
+        unsigned node(ParseForest::NodeType type, unsigned id, unsigned dot, unsigned start, unsigned end) {
+            const auto known = index.find({ type, id, dot, start, end });
+            if (known != index.end()) {
+                return known->second;
+            }
+
+            const unsigned result = nodes.size();
+            nodes.push_back({ type, id, dot, start, end, {} });
+            index.emplace(ForestKey{ type, id, dot, start, end }, result);
+            if (type == ParseForest::NodeType::SYMBOL || type == ParseForest::NodeType::ITEM) {
+                pending.push_back(result);
+            }
+            return result;
+        }
+
+        // the node of the prefix of an item one symbol shorter, which ends in <end>
+        unsigned prefix(const EarleyItem &item, unsigned end) {
+            return item.dot == 0 ? ParseForest::NONE : node(ParseForest::NodeType::ITEM, item.rule, item.dot, item.start, end);
+        }
+
+        void addPacked(unsigned target, unsigned left, unsigned right) {
+            std::vector<std::pair<unsigned, unsigned>> &packed = nodes[target].packed;
+            if (std::find(packed.begin(), packed.end(), std::make_pair(left, right)) == packed.end()) {
+                packed.emplace_back(left, right);
+            }
+        }
+
+        const std::vector<unsigned> *completedItems(Nonterminal n, unsigned start, unsigned end) {
+            if (!completed_indexed[end]) {
+                const Column &column = DP.at(end);
+                for (unsigned row = 0; row < column.size(); row++) {
+                    const EarleyItem &item = column.at(row);
+                    if (!nextSymbol(cg, item)) {
+                        completed[end][(std::uint64_t{ cg.getFrom(item.rule) } << 32) | item.start].push_back(row);
+                    }
+                }
+                completed_indexed[end] = true;
+            }
+
+            const auto it = completed[end].find((std::uint64_t{ n } << 32) | start);
+            return it == completed[end].end() ? nullptr : &it->second;
+        }
+
+        void expandSymbol(unsigned target) {
+            const ParseForest::Node current = nodes[target];
+            const std::vector<unsigned> *rows = completedItems(current.id, current.start, current.end);
+            if (!rows) {
+                return;
+            }
+
+            for (unsigned row : *rows) {
+                const EarleyItem &item = DP.at(current.end).at(row);
+                addPacked(target, ParseForest::NONE, node(ParseForest::NodeType::ITEM, item.rule, item.dot, item.start, current.end));
+            }
+        }
+
+        void expandItem(unsigned target) {
+            const ParseForest::Node current = nodes[target];
+            const Column &column = DP.at(current.end);
+
+            const EarleyItem *item = column.find({ current.start, current.id, current.dot, EarleyItem::DerivationType::ROOT, { { 0, 0 }, { 0, 0 } } });
+            for (; item; item = item->alternative == NO_ALTERNATIVE ? nullptr : &column.alternatives.at(item->alternative)) {
+                expandDerivation(target, current, *item);
+            }
+        }
+
+        void expandDerivation(unsigned target, const ParseForest::Node &current, const EarleyItem &derivation) {
+            const auto &backpointer = derivation.backpointer;
+
+            switch (derivation.type) {
                 case EarleyItem::DerivationType::SCAN:
-                    current_item = &DP.at(current_item->backpointer.first.first).at(current_item->backpointer.first.second);
+                    addPacked(target, prefix(DP.at(backpointer.first.first).at(backpointer.first.second), backpointer.first.first),
+                        node(ParseForest::NodeType::TERMINAL, input.at(backpointer.first.first), 0, backpointer.first.first, current.end));
                     break;
                 case EarleyItem::DerivationType::NULLABLE_SCAN:
-                    result.subtrees.push_back(getNullTree(g, current_item->pre.back().n));
-                    current_item = &DP.at(current_item->backpointer.first.first).at(current_item->backpointer.first.second);
+                    addPacked(target, prefix(DP.at(backpointer.first.first).at(backpointer.first.second), backpointer.first.first),
+                        node(ParseForest::NodeType::NULLED, cg.getRule(current.id).at(current.dot - 1).n, 0, current.end, current.end));
+                    break;
+                case EarleyItem::DerivationType::NULL_PREFIX:
+                    addPacked(target, current.dot > 1 ? node(ParseForest::NodeType::ITEM, current.id, current.dot - 1, current.start, current.end) : ParseForest::NONE,
+                        node(ParseForest::NodeType::NULLED, cg.getRule(current.id).at(current.dot - 1).n, 0, current.end, current.end));
                     break;
                 case EarleyItem::DerivationType::COMPLETE:
-                    result.subtrees.push_back(backtrack(g, DP, DP.at(current_item->backpointer.second.first).at(current_item->backpointer.second.second)));
-                    current_item = &DP.at(current_item->backpointer.first.first).at(current_item->backpointer.first.second);
+                    {
+                        // empty completions are the same derivations as the nullable scans
+                        const EarleyItem &child = DP.at(backpointer.second.first).at(backpointer.second.second);
+                        if (child.start == current.end) {
+                            break;
+                        }
+                        addPacked(target, prefix(DP.at(backpointer.first.first).at(backpointer.first.second), backpointer.first.first),
+                            node(ParseForest::NodeType::SYMBOL, cg.getFrom(child.rule), 0, child.start, current.end));
+                    }
+                    break;
+                case EarleyItem::DerivationType::LEO:
+                    {
+                        const EarleyItem &child = DP.at(backpointer.second.first).at(backpointer.second.second);
+                        unsigned right = node(ParseForest::NodeType::SYMBOL, cg.getFrom(child.rule), 0, child.start, current.end);
+                        std::pair<unsigned, unsigned> position = backpointer.first;
+
+                        for (;;) {
+                            const EarleyItem &parent = DP.at(position.first).at(position.second);
+                            const unsigned left = prefix(parent, position.first);
+                            unsigned above;
+                            if (!leoAbove(cg, DP, parent, position.first, above)) {
+                                addPacked(target, left, right);
+                                break;
+                            }
+
+                            const unsigned skipped = node(ParseForest::NodeType::ITEM, parent.rule, parent.dot + 1, parent.start, current.end);
+                            addPacked(skipped, left, right);
+
+                            right = node(ParseForest::NodeType::SYMBOL, cg.getFrom(parent.rule), 0, parent.start, current.end);
+                            addPacked(right, ParseForest::NONE, skipped);
+                            position = { parent.start, above };
+                        }
+                    }
                     break;
                 case EarleyItem::DerivationType::ROOT:    // never reached
                 case EarleyItem::DerivationType::PREDICT: // never reached
@@ -295,52 +743,1110 @@ namespace cfg {
             }
         }
 
-        std::reverse(result.subtrees.begin(), result.subtrees.end());
+    public:
 
-        return result;
+        ForestBuilder(const CompiledGrammar &cg, const Table &DP, const String &input) :
+            cg(cg), DP(DP), input(input), completed(DP.size()), completed_indexed(DP.size(), false) {}
+
+        // CONTRACT: <target> is a complete item of the last column
+        unsigned build(const EarleyItem &target) {
+            const unsigned root = node(ParseForest::NodeType::ITEM, target.rule, target.dot, target.start, DP.size() - 1);
+
+            while (!pending.empty()) {
+                const unsigned next = pending.back();
+                pending.pop_back();
+
+                if (nodes[next].type == ParseForest::NodeType::SYMBOL) {
+                    expandSymbol(next);
+                } else {
+                    expandItem(next);
+                }
+            }
+
+            return root;
+        }
+
+        inline std::vector<ParseForest::Node> &getNodes() { return nodes; }
+    };
+
+    // runs the scanner, completer and predictor over every item of column <col>. The
+    // lookahead needs input[col] and a scan up to the scan window of the grammar from
+    // there, so a column can only be processed once that much is known, or once the
+    // input is known to end before
+    // CONTRACT: DP has a column for every position of the input up to its end
+    static void processColumn(const CompiledGrammar &cg, const String &input, Table &DP, unsigned col, PredictionSet &predicted, TraceSink *trace) {
+        predicted.reset();
+        for (unsigned j = 0; j < DP.at(col).size(); j++) {
+            CFG_TRACE_STEP(trace, "[" + std::to_string(col) + "/" + std::to_string(j) + "] " + itemToString(cg, DP.at(col).at(j)));
+            scan(cg, input, DP, col, j);
+            scanExtra(cg, input, DP, col, j);
+            complete(cg, input, DP, col, j);
+            predict(cg, input, DP, col, j, predicted);
+        }
     }
 
-    EarleyParser::EarleyParser() {}
+    static Table recognize(const CompiledGrammar &cg, const String &input, TraceSink *trace) {
+        Table DP;
 
-    void EarleyParser::initGrammar(const std::string &filename) {
-        gm.parseFromFile(filename);
+        DP.resize(input.size() + 1);
+        DP.at(0).add(cg, { 0, cg.getRootRule(), 0, EarleyItem::DerivationType::ROOT, { { 0, 0 }, { 0, 0 } } });
+
+        PredictionSet predicted(cg.getNonterminalCount());
+
+        for (unsigned i = 0; i < DP.size(); i++) {
+            processColumn(cg, input, DP, i, predicted, trace);
+        }
+
+        return DP;
     }
 
-    bool EarleyParser::parseInput(const String &input) {
-        return parseTree(input).first;
+    // returns the complete root item of <column>, or nullptr if the input read up to it is rejected
+    static const EarleyItem *findRoot(const CompiledGrammar &cg, const Column &column) {
+        const unsigned root_rule = cg.getRootRule();
+        auto it = std::find_if(column.items.begin(), column.items.end(),
+            [root_rule] (const EarleyItem &i) -> bool { return i.rule == root_rule && i.dot == 1; });
+        return it == column.items.end() ? nullptr : &*it;
+    }
+
+    // the syntax tree of a finished table, empty if the input is rejected
+    static SyntaxTree buildSyntaxTree(const std::shared_ptr<const CompiledGrammar> &grammar, const Table &DP, const String &input) {
+        const EarleyItem *root = findRoot(*grammar, DP.back());
+        if (!root) {
+            return SyntaxTree();
+        }
+
+        TreeArena arena;
+        backtrack(*grammar, DP, *root, DP.size() - 1, arena);
+        return SyntaxTree(grammar, input, toSyntaxNodes(*grammar, arena));
+    }
+
+    // traces the table, then builds and refines the tree of a finished table
+    static std::pair<bool, ProductionTree> buildTree(const std::shared_ptr<const CompiledGrammar> &grammar, const Table &DP, const String &input, const GrammarManager &gm, TraceSink *trace) {
+        if (trace && trace->enabled(TraceLevel::TABLE)) {
+            trace->write(TraceLevel::TABLE, printTable(*grammar, DP, input));
+        }
+
+        const SyntaxTree syntax_tree = buildSyntaxTree(grammar, DP, input);
+        if (syntax_tree.empty()) {
+            return { false, FAILED_PARSE };
+        }
+
+        if (trace && trace->enabled(TraceLevel::TREE)) {
+            trace->write(TraceLevel::TREE, gm.printTree(syntax_tree.toProductionTree(false)));
+        }
+        ProductionTree tree = syntax_tree.toProductionTree();
+        if (trace && trace->enabled(TraceLevel::TREE)) {
+            trace->write(TraceLevel::TREE, gm.printTree(tree));
+        }
+        return { true, tree };
     }
 
-    std::pair<bool, ProductionTree> EarleyParser::parseTree(const String &input) {
-        std::map<Nonterminal, bool> nullables = getNullableRules(gm.g);
-        nullables[ROOT] = nullables.at(S);
+    // the columns of a session: all columns before <processed> are finished, the ones
+    // from <processed> on hold the items scanned into them so far. Only the scan
+    // window of the grammar behind <processed> can be reached by the scans still to come
+    struct EarleyParser::Session::State {
+        EarleyParser *parser;
+        std::shared_ptr<const CompiledGrammar> grammar;
 
+        String input;
         Table DP;
+        PredictionSet predicted;
+        unsigned processed;
+        bool finished;
 
-        DP.resize(input.size() + 1);
-        DP.at(0).push_back(EarleyItem{ 0, ROOT, Symbols{}, Symbols{ { false, { .n = S } } }, EarleyItem::DerivationType::ROOT, { { 0, 0 }, { 0, 0 } } });
+        State(EarleyParser *parser) :
+            parser(parser), grammar(parser->grammar), predicted(grammar->getNonterminalCount()), processed(0), finished(false) {}
 
-        for (unsigned i = 0; i < DP.size(); i++) {
-            for (unsigned j = 0; j < DP.at(i).size(); j++) {
-                scan(gm.g, input, DP, i, j);
-                scanExtra(gm.g, input, DP, i, j, nullables);
-                complete(gm.g, input, DP, i, j);
-                predict(gm.g, input, DP, i, j);
+        inline bool isViable() const {
+            const std::size_t reach = std::min<std::size_t>(processed + grammar->getScanWindow(), DP.size());
+            return std::any_of(DP.begin() + processed, DP.begin() + reach, [] (const Column &column) { return column.size() > 0; });
+        }
+    };
+
+    EarleyParser::Session::Session(EarleyParser *parser) : state(std::make_unique<State>(parser)) {
+        const CompiledGrammar &cg = *state->grammar;
+        state->DP.resize(1);
+        state->DP.at(0).add(cg, { 0, cg.getRootRule(), 0, EarleyItem::DerivationType::ROOT, { { 0, 0 }, { 0, 0 } } });
+    }
+
+    EarleyParser::Session::Session(Session &&) = default;
+    EarleyParser::Session &EarleyParser::Session::operator = (Session &&) = default;
+    EarleyParser::Session::~Session() = default;
+
+    bool EarleyParser::Session::feed(const String &chunk) {
+        State &s = *state;
+        if (s.finished || !s.isViable()) {
+            return false;
+        }
+
+        s.input.insert(s.input.end(), chunk.begin(), chunk.end());
+        s.DP.resize(s.input.size() + 1);
+
+        // every column whose scan window is known can be finished; stop once no item
+        // is left that could scan further
+        while (s.processed + s.grammar->getScanWindow() <= s.input.size()) {
+            processColumn(*s.grammar, s.input, s.DP, s.processed, s.predicted, s.parser->trace);
+            s.processed++;
+
+            if (!s.isViable()) {
+                return false;
             }
         }
 
-        std::cout << gm.debugInfo() << "\n\n" << printTable(DP, input) << "\n\n";
+        return true;
+    }
+
+    bool EarleyParser::Session::isViablePrefix() const {
+        return !state->finished && state->isViable();
+    }
+
+    // processes the unfinished columns as if the input ended here, on copies that
+    // are put back afterwards; only the Leo items of finished columns are memoized
+    bool EarleyParser::Session::acceptsHere() const {
+        State &s = *state;
+        if (!isViablePrefix()) {
+            return false;
+        }
+
+        Table frontier(s.DP.begin() + s.processed, s.DP.end());
+        for (unsigned col = s.processed; col < s.DP.size(); col++) {
+            processColumn(*s.grammar, s.input, s.DP, col, s.predicted, s.parser->trace);
+        }
+        const bool accepted = findRoot(*s.grammar, s.DP.back()) != nullptr;
+        std::move(frontier.begin(), frontier.end(), s.DP.begin() + s.processed);
+
+        return accepted;
+    }
 
-        auto it = std::find_if(DP.back().begin(), DP.back().end(),
-            [] (EarleyItem i) -> bool { return i.from == ROOT && i.post.empty(); });
-        if (it == DP.back().end()) {
+    std::pair<bool, ProductionTree> EarleyParser::Session::finish() {
+        State &s = *state;
+        if (!isViablePrefix()) {
+            s.finished = true;
             return { false, FAILED_PARSE };
         }
 
-        ProductionTree tree = backtrack(gm.g, DP, *it);
-        std::cout << gm.printTree(tree) << "\n\n";
-        tree = gm.refineTree(tree);
-        std::cout << gm.printTree(tree) << "\n\n";
-        return { true, tree };
+        s.finished = true;
+        for (; s.processed < s.DP.size(); s.processed++) {
+            processColumn(*s.grammar, s.input, s.DP, s.processed, s.predicted, s.parser->trace);
+        }
+        return buildTree(s.grammar, s.DP, s.input, s.parser->gm, s.parser->trace);
+    }
+
+    // the text of a document and its finished table, whose last column is processed
+    // as the end of the input; finished columns need no hash index, so the columns
+    // taken over from an older table are left without one
+    struct EarleyParser::Document::State {
+        EarleyParser *parser;
+        std::shared_ptr<const CompiledGrammar> grammar;
+
+        String input;
+        Table DP;
+        PredictionSet predicted;
+        std::size_t processed;
+
+        State(EarleyParser *parser) :
+            parser(parser), grammar(parser->grammar), predicted(grammar->getNonterminalCount()), processed(0) {}
+    };
+
+    // Decides whether the rest of the old table can be taken over behind new column
+    // <col> after an edit at <offset>, once the input behind the last <window> columns
+    // up to it is the same as behind their old counterparts. The old columns then only
+    // ever look back at the items of those columns that are not complete (through
+    // scans and backpointers), and at the items of an earlier column waiting for a
+    // nonterminal that an item started there and still running in one of them may
+    // complete (through completions and Leo items), recursively. Each of the <window>
+    // columns has to hold the same dotted rules in the same rows as its old
+    // counterpart, and each earlier column the same waiting items in the same rows
+    // for those nonterminals. Their starts have to lie before the edit or in
+    // corresponding columns again; the new column of every old column found this way
+    // is kept in <renumbered>.
+    static bool converges(const CompiledGrammar &cg, const Table &DP, unsigned col, const Table &old_columns, unsigned old_col, unsigned offset,
+            unsigned window, std::unordered_map<unsigned, unsigned> &renumbered) {
+        std::unordered_map<unsigned, unsigned> pairs;
+        std::unordered_set<std::uint64_t> visited;
+        std::vector<std::pair<unsigned, Nonterminal>> pending;
+
+        // the starts of two items in the same row have to correspond; the waiting items
+        // the nonterminal of the items may complete into are checked later on
+        auto correspond = [&] (const EarleyItem &item, const EarleyItem &old_item) {
+            if (item.start < offset || old_item.start < offset) {
+                return item.start == old_item.start;
+            }
+
+            const auto known = pairs.find(item.start);
+            const auto old_known = renumbered.find(old_item.start);
+            if (known != pairs.end() || old_known != renumbered.end()) {
+                if (known == pairs.end() || old_known == renumbered.end() || known->second != old_item.start) {
+                    return false;
+                }
+            } else {
+                pairs.emplace(item.start, old_item.start);
+                renumbered.emplace(old_item.start, item.start);
+            }
+
+            const Nonterminal from = cg.getFrom(item.rule);
+            if (item.start + window <= col && from != ROOT && visited.insert((std::uint64_t{ item.start } << 32) | from).second) {
+                pending.emplace_back(item.start, from);
+            }
+            return true;
+        };
+
+        renumbered.clear();
+        for (unsigned c = col + 1 - window; c <= col; c++) {
+            pairs.emplace(c, old_col - (col - c));
+            renumbered.emplace(old_col - (col - c), c);
+        }
+
+        for (unsigned c = col + 1 - window; c <= col; c++) {
+            const Column &column = DP.at(c), &old_column = old_columns.at(pairs.at(c) - offset);
+            if (column.size() != old_column.size()) {
+                return false;
+            }
+            for (unsigned row = 0; row < column.size(); row++) {
+                const EarleyItem &item = column.at(row), &old_item = old_column.at(row);
+                if (item.rule != old_item.rule || item.dot != old_item.dot) {
+                    return false;
+                }
+                if (nextSymbol(cg, item) && !correspond(item, old_item)) {
+                    return false;
+                }
+            }
+        }
+
+        while (!pending.empty()) {
+            const auto [origin, n] = pending.back();
+            pending.pop_back();
+
+            const Column &waiting = DP.at(origin), &old_waiting = old_columns.at(pairs.at(origin) - offset);
+            const auto rows = waiting.waiting.find(n), old_rows = old_waiting.waiting.find(n);
+            if (rows == waiting.waiting.end() || old_rows == old_waiting.waiting.end()) {
+                if (rows != waiting.waiting.end() || old_rows != old_waiting.waiting.end()) {
+                    return false;
+                }
+                continue;
+            }
+            if (rows->second != old_rows->second) {
+                return false;
+            }
+
+            for (unsigned row : rows->second) {
+                const EarleyItem &item = waiting.at(row), &old_item = old_waiting.at(row);
+                if (item.rule != old_item.rule || item.dot != old_item.dot || !correspond(item, old_item)) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // renumbers the columns an old column taken over after an edit at <offset> refers
+    // to: those before the edit stay, those after <old_col> move by <delta>, and the
+    // others are found in <renumbered>; finished columns need no hash index
+    static void renumberColumn(Column &column, unsigned offset, unsigned old_col, long delta, const std::unordered_map<unsigned, unsigned> &renumbered) {
+        auto renumber = [&] (unsigned &col) {
+            if (col > old_col) {
+                col += delta;
+            } else if (col >= offset) {
+                col = renumbered.at(col);
+            }
+        };
+
+        auto renumberItem = [&renumber] (EarleyItem &item) {
+            renumber(item.start);
+            switch (item.type) {
+                case EarleyItem::DerivationType::COMPLETE:
+                case EarleyItem::DerivationType::LEO:
+                    renumber(item.backpointer.second.first);
+                    [[fallthrough]];
+                case EarleyItem::DerivationType::SCAN:
+                case EarleyItem::DerivationType::NULLABLE_SCAN:
+                case EarleyItem::DerivationType::PREDICT:
+                case EarleyItem::DerivationType::NULL_PREFIX:
+                    renumber(item.backpointer.first.first);
+                    break;
+                case EarleyItem::DerivationType::ROOT:
+                    break;
+            }
+        };
+
+        for (EarleyItem &item : column.items) {
+            renumberItem(item);
+        }
+        for (EarleyItem &item : column.alternatives) {
+            renumberItem(item);
+        }
+        for (auto &leo : column.leo) {
+            renumber(leo.second.top.first);
+        }
+        column.index.clear();
+    }
+
+    EarleyParser::Document::Document(EarleyParser *parser) : state(std::make_unique<State>(parser)) {
+        assign({});
+    }
+
+    EarleyParser::Document::Document(Document &&) = default;
+    EarleyParser::Document &EarleyParser::Document::operator = (Document &&) = default;
+    EarleyParser::Document::~Document() = default;
+
+    bool EarleyParser::Document::assign(const String &input) {
+        State &s = *state;
+
+        s.input = input;
+        s.DP = recognize(*s.grammar, s.input, s.parser->trace);
+        s.processed = s.DP.size();
+
+        return accepted();
+    }
+
+    bool EarleyParser::Document::edit(std::size_t offset, std::size_t removed, const String &inserted) {
+        State &s = *state;
+        const CompiledGrammar &cg = *s.grammar;
+
+        if (offset > s.input.size() || removed > s.input.size() - offset) {
+            throw std::out_of_range("edit outside of the document");
+        }
+
+        const unsigned o = offset, k = removed, m = inserted.size();
+        const long delta = long(m) - long(k);
+        const unsigned window = cg.getScanWindow();
+
+        // the columns before the edit stay; the old ones from the edit on may be taken over
+        Table old_columns(std::make_move_iterator(s.DP.begin() + o), std::make_move_iterator(s.DP.end()));
+        s.DP.resize(o);
+
+        s.input.erase(s.input.begin() + o, s.input.begin() + o + k);
+        s.input.insert(s.input.begin() + o, inserted.begin(), inserted.end());
+
+        // the columns from <o> on start over from what the columns before scan into them
+        s.DP.resize(s.input.size() + 1);
+        if (o == 0) {
+            s.DP.at(0).add(cg, { 0, cg.getRootRule(), 0, EarleyItem::DerivationType::ROOT, { { 0, 0 }, { 0, 0 } } });
+        }
+        for (unsigned col = o < window ? 0 : o - window; col < o; col++) {
+            for (unsigned row = 0; row < s.DP.at(col).size(); row++) {
+                const Symbol *next = nextSymbol(cg, s.DP.at(col).at(row));
+                if (next && next->isTerminal && col + cg.getLength(*next) >= o) {
+                    scan(cg, s.input, s.DP, col, row);
+                }
+            }
+        }
+
+        std::unordered_map<unsigned, unsigned> renumbered;
+
+        s.processed = 0;
+        for (unsigned col = o; col <= s.input.size(); col++) {
+            processColumn(cg, s.input, s.DP, col, s.predicted, s.parser->trace);
+            s.processed++;
+
+            // nothing follows once the columns the scans from here on may reach are
+            // empty, the rest of the document is rejected
+            const std::size_t reach = std::min<std::size_t>(col + window, s.input.size());
+            if (std::all_of(s.DP.begin() + col + 1, s.DP.begin() + reach + 1, [] (const Column &column) { return column.size() == 0; })) {
+                break;
+            }
+
+            if (col + 1 < o + m + window) {
+                continue;
+            }
+
+            const unsigned old_col = col - delta;
+            if (converges(cg, s.DP, col, old_columns, old_col, o, window, renumbered)) {
+                s.DP.resize(col + 1);
+                for (unsigned i = old_col - o + 1; i < old_columns.size(); i++) {
+                    renumberColumn(old_columns.at(i), o, old_col, delta, renumbered);
+                    s.DP.push_back(std::move(old_columns.at(i)));
+                }
+                break;
+            }
+        }
+
+        return accepted();
+    }
+
+    bool EarleyParser::Document::accepted() const {
+        return findRoot(*state->grammar, state->DP.back()) != nullptr;
+    }
+
+    const String &EarleyParser::Document::getInput() const {
+        return state->input;
+    }
+
+    std::size_t EarleyParser::Document::getProcessedColumns() const {
+        return state->processed;
+    }
+
+    std::pair<bool, ProductionTree> EarleyParser::Document::tree() {
+        State &s = *state;
+        return buildTree(s.grammar, s.DP, s.input, s.parser->gm, s.parser->trace);
+    }
+
+    // an Earley item of the recognizer: no derivation type, backpointers or alternatives
+    struct RecognizerItem {
+        unsigned start;
+        unsigned rule, dot;
+
+        inline bool operator == (const RecognizerItem &i) const {
+            return start == i.start && rule == i.rule && dot == i.dot;
+        }
+    };
+
+    struct RecognizerItemHash {
+        inline std::size_t operator () (const RecognizerItem &i) const {
+            std::size_t h = i.start;
+            auto combine = [&h] (std::size_t v) { h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2); };
+
+            combine(i.rule);
+            combine(i.dot);
+            return h;
+        }
+    };
+
+    static inline const Symbol *nextSymbol(const CompiledGrammar &cg, const RecognizerItem &item) {
+        const Rule &rule = cg.getRule(item.rule);
+        return item.dot < rule.size() ? &rule[item.dot] : nullptr;
+    }
+
+    // A hash map with open addressing and linear probing. clear() only frees the slots
+    // in use and keeps all of them for the next use, so a map that is cleared and filled
+    // again and again stops allocating once it has grown to the largest size it needs.
+    // Pointers to values stay valid until the next insert().
+    template<typename Key, typename Value, typename Hash>
+    class FlatMap {
+
+    private:
+
+        struct Slot {
+            Key key;
+            Value value;
+            bool used = false;
+        };
+
+        std::vector<Slot> slots; // a power of two of them, at most half of them in use
+        std::vector<unsigned> filled; // the slots in use, in insertion order
+        unsigned shift = 64;
+
+        // the slot of <key>, or the free slot it belongs to; Fibonacci hashing spreads
+        // hashes that only differ in their high bits over the whole table
+        unsigned probe(const Key &key) const {
+            const std::size_t mask = slots.size() - 1;
+            std::size_t i = (std::uint64_t{ Hash{}(key) } * 0x9e3779b97f4a7c15ull) >> shift;
+            while (slots[i].used && !(slots[i].key == key)) {
+                i = (i + 1) & mask;
+            }
+            return i;
+        }
+
+        void grow() {
+            std::vector<Slot> old(slots.empty() ? 16 : 2 * slots.size());
+            old.swap(slots);
+            shift = 64 - std::countr_zero(slots.size());
+
+            for (unsigned &i : filled) {
+                const unsigned moved = probe(old[i].key);
+                slots[moved] = old[i];
+                i = moved;
+            }
+        }
+
+    public:
+
+        inline std::size_t size() const { return filled.size(); }
+
+        // returns the value of <key>, or nullptr if the key is not in the map
+        const Value *find(const Key &key) const {
+            if (slots.empty()) {
+                return nullptr;
+            }
+            const unsigned i = probe(key);
+            return slots[i].used ? &slots[i].value : nullptr;
+        }
+
+        // returns the value of <key>, which is set to <value> first if the key is new,
+        // and whether it is
+        std::pair<Value *, bool> insert(const Key &key, const Value &value) {
+            if (2 * (filled.size() + 1) > slots.size()) {
+                grow();
+            }
+
+            const unsigned i = probe(key);
+            if (slots[i].used) {
+                return { &slots[i].value, false };
+            }
+            slots[i] = { key, value, true };
+            filled.push_back(i);
+            return { &slots[i].value, true };
+        }
+
+        void clear() {
+            for (unsigned i : filled) {
+                slots[i].used = false;
+            }
+            filled.clear();
+        }
+
+        // calls <f> with every key and its value, in insertion order
+        template<typename F>
+        void forEach(F f) const {
+            for (unsigned i : filled) {
+                f(slots[i].key, slots[i].value);
+            }
+        }
+    };
+
+    // The live columns of a recognizer and the items of column <col>, which is being
+    // processed, and of the columns a scan from there may reach: column col + d is
+    // kept in ahead[(col + d) % window] for the scan window of the grammar. The input
+    // from a column on is buffered until the window of the column is known. Of a column the recognizer keeps for every
+    // nonterminal the items to advance once it is completed there. While the column is
+    // processed these are the items waiting for it. Once it is finished, an item whose
+    // rule ends with the nonterminal and started earlier is replaced by the items its
+    // own completion advances there, so completions follow reduction paths to their
+    // tops in one step (like LeoItem, but for any number of parents) and the columns
+    // along the paths need not be kept.
+    // Nonterminal A of column j can only be completed again while an item of A started
+    // in j is alive: one that will be processed, or a kept item another completion
+    // would advance. Everything else is garbage; it is collected whenever the kept
+    // items doubled since the last collection, so they never take more than twice the
+    // memory of the live ones. Lists of collected items are recycled rather than freed
+    // and every other buffer is cleared rather than released, so a recognizer reset()
+    // for the next input reuses the memory of the last one.
+    struct RecognizerState {
+        static constexpr std::size_t MIN_COLLECTION = 1 << 12;
+
+        std::shared_ptr<const CompiledGrammar> grammar;
+
+        // the list of items to advance when A started in column j is completed, under
+        // the key j << 32 | A; a list is marked while a collection finds it alive. Every
+        // input takes the lists in the same order, from <unused> on and then the ones
+        // collected, so each one keeps the capacity the same role needed last time
+        FlatMap<std::uint64_t, unsigned, std::hash<std::uint64_t>> waiting;
+        std::deque<std::vector<RecognizerItem>> lists;
+        std::vector<bool> marked;
+        std::vector<unsigned> free_lists;
+        unsigned unused;
+        std::vector<std::pair<Nonterminal, unsigned>> waiting_here; // the lists of column <col>
+
+        std::vector<RecognizerItem> current, tops;
+        std::vector<std::vector<RecognizerItem>> ahead;
+        String buffered;
+        FlatMap<RecognizerItem, bool, RecognizerItemHash> known;
+        PredictionSet predicted;
+
+        std::vector<unsigned> pending;
+        std::vector<std::pair<std::uint64_t, unsigned>> survivors;
+
+        unsigned col;
+        std::size_t kept, collection;
+        std::size_t kept_columns, peak;
+        bool finished;
+
+        RecognizerState() : unused(0), predicted(0) {}
+
+        static inline std::uint64_t key(unsigned origin, Nonterminal n) {
+            return (std::uint64_t{ origin } << 32) | n;
+        }
+
+        // starts over on a new input; all buffers keep their capacity
+        void reset(const std::shared_ptr<const CompiledGrammar> &cg) {
+            if (grammar != cg) {
+                grammar = cg;
+            }
+            if (predicted.predicted.size() != grammar->getNonterminalCount()) {
+                predicted = PredictionSet(grammar->getNonterminalCount());
+            }
+            predicted.reset();
+
+            waiting.forEach([this] (std::uint64_t, unsigned list) {
+                lists[list].clear();
+            });
+            waiting.clear();
+            free_lists.clear();
+            unused = 0;
+            waiting_here.clear();
+            current.clear();
+            ahead.resize(grammar->getScanWindow());
+            for (std::vector<RecognizerItem> &items : ahead) {
+                items.clear();
+            }
+            buffered.clear();
+            known.clear();
+
+            col = 0;
+            kept = 0;
+            collection = MIN_COLLECTION;
+            kept_columns = 0;
+            peak = 1;
+            finished = false;
+
+            add({ 0, grammar->getRootRule(), 0 });
+        }
+
+        inline bool isViable() const {
+            return !current.empty() || std::any_of(ahead.begin(), ahead.end(), [] (const std::vector<RecognizerItem> &items) { return !items.empty(); });
+        }
+
+        // the finished columns with kept items, and column <col>
+        inline std::size_t liveColumns() const { return kept_columns + 1; }
+
+        // the items to advance when <n> started in column <origin> is completed, or
+        // nullptr if there are none; the list stays where it is while lists are added
+        const std::vector<RecognizerItem> *parentsOf(unsigned origin, Nonterminal n) const {
+            const unsigned *list = waiting.find(key(origin, n));
+            return list ? &lists[*list] : nullptr;
+        }
+
+        // the list of items waiting for <n> in column <col>, which is added if there is none
+        std::vector<RecognizerItem> &waitingHere(Nonterminal n) {
+            const auto [list, added] = waiting.insert(key(col, n), 0);
+            if (added) {
+                if (!free_lists.empty()) {
+                    *list = free_lists.back();
+                    free_lists.pop_back();
+                } else {
+                    if (unused == lists.size()) {
+                        lists.emplace_back();
+                        marked.push_back(false);
+                    }
+                    *list = unused++;
+                }
+                waiting_here.emplace_back(n, *list);
+            }
+            return lists[*list];
+        }
+
+        void add(const RecognizerItem &item) {
+            if (!known.insert(item, true).second) {
+                return;
+            }
+
+            const Symbol *next = nextSymbol(*grammar, item);
+            if (next && !next->isTerminal) {
+                waitingHere(next->n).push_back(item);
+            }
+            current.push_back(item);
+        }
+
+        // runs the scanner, completer and predictor over column <col>, the same way
+        // processColumn() does; <lookahead> is nullptr at the end of the input, and
+        // otherwise followed by the rest of the <available> terminals known
+        void process(const Terminal *lookahead, std::size_t available) {
+            const CompiledGrammar &cg = *grammar;
+
+            predicted.reset();
+            for (unsigned j = 0; j < current.size(); j++) {
+                const RecognizerItem item = current[j];
+                const Symbol *symbol = nextSymbol(cg, item);
+
+                if (!symbol) {
+                    // only visit the items waiting for the completed nonterminal; the
+                    // list of this column can grow while iterating
+                    const std::vector<RecognizerItem> *parents = parentsOf(item.start, cg.getFrom(item.rule));
+                    for (unsigned i = 0; parents && i < parents->size(); i++) {
+                        const RecognizerItem parent = (*parents)[i];
+                        add({ parent.start, parent.rule, parent.dot + 1 });
+                    }
+                } else if (symbol->isTerminal) {
+                    if (lookahead && cg.scans(*symbol, lookahead, available)) {
+                        ahead[(col + cg.getLength(*symbol)) % ahead.size()].push_back({ item.start, item.rule, item.dot + 1 });
+                    }
+                } else {
+                    if (cg.isNullable(symbol->n)) {
+                        add({ item.start, item.rule, item.dot + 1 });
+                    }
+                    if (!predicted.contains(symbol->n)) {
+                        for (Nonterminal n : cg.getClosure(symbol->n)) {
+                            if (!predicted.insert(n)) {
+                                continue;
+                            }
+                            for (const auto &[rule, dot] : cg.getPredictions(n)) {
+                                if (matchesLookahead(cg, rule, dot, lookahead)) {
+                                    add({ col, rule, dot });
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // replaces the items of the processed column that complete along a reduction
+        // path by the tops of the path; then the column after it is the one to process
+        void advance() {
+            const CompiledGrammar &cg = *grammar;
+
+            for (const auto &[n, list] : waiting_here) {
+                std::vector<RecognizerItem> &parents = lists[list];
+                tops.clear();
+                bool merged = false;
+
+                for (const RecognizerItem &parent : parents) {
+                    const Nonterminal from = cg.getFrom(parent.rule);
+                    if (parent.start == col || from == ROOT || parent.dot + 1 != cg.getRule(parent.rule).size()) {
+                        tops.push_back(parent);
+                        continue;
+                    }
+
+                    if (const std::vector<RecognizerItem> *above = parentsOf(parent.start, from)) {
+                        tops.insert(tops.end(), above->begin(), above->end());
+                    }
+                    merged = true;
+                }
+
+                if (merged) {
+                    std::sort(tops.begin(), tops.end(), [] (const RecognizerItem &a, const RecognizerItem &b) {
+                        return std::tie(a.start, a.rule, a.dot) < std::tie(b.start, b.rule, b.dot);
+                    });
+                    tops.erase(std::unique(tops.begin(), tops.end()), tops.end());
+                    parents = tops;
+                }
+                kept += parents.size();
+            }
+            if (!waiting_here.empty()) {
+                kept_columns++;
+            }
+
+            col++;
+            waiting_here.clear();
+
+            current.swap(ahead[col % ahead.size()]);
+            ahead[col % ahead.size()].clear();
+            known.clear();
+            for (const RecognizerItem &item : current) {
+                known.insert(item, true);
+
+                const Symbol *symbol = nextSymbol(cg, item);
+                if (symbol && !symbol->isTerminal) {
+                    waitingHere(symbol->n).push_back(item);
+                }
+            }
+
+            if (kept >= collection) {
+                collect();
+            }
+            peak = std::max(peak, liveColumns());
+        }
+
+        // marks what the items of column <col> may complete, and whatever the kept items
+        // marked that way may complete in turn; recycles the rest of the finished columns
+        void collect() {
+            const CompiledGrammar &cg = *grammar;
+
+            auto mark = [&] (const RecognizerItem &item) {
+                const Nonterminal from = cg.getFrom(item.rule);
+                if (item.start == col || from == ROOT) {
+                    return;
+                }
+                const unsigned *list = waiting.find(key(item.start, from));
+                if (list && !marked[*list]) {
+                    marked[*list] = true;
+                    pending.push_back(*list);
+                }
+            };
+
+            for (const RecognizerItem &item : current) {
+                mark(item);
+            }
+            for (const std::vector<RecognizerItem> &items : ahead) {
+                for (const RecognizerItem &item : items) {
+                    mark(item);
+                }
+            }
+            while (!pending.empty()) {
+                const unsigned list = pending.back();
+                pending.pop_back();
+
+                for (const RecognizerItem &parent : lists[list]) {
+                    mark(parent);
+                }
+            }
+
+            // the map is rebuilt from the lists that survive, in the order of their columns
+            kept = 0;
+            survivors.clear();
+            waiting.forEach([this] (std::uint64_t k, unsigned list) {
+                if ((k >> 32) == col) {
+                    survivors.emplace_back(k, list);
+                } else if (marked[list]) {
+                    marked[list] = false;
+                    kept += lists[list].size();
+                    survivors.emplace_back(k, list);
+                } else {
+                    lists[list].clear();
+                    free_lists.push_back(list);
+                }
+            });
+            std::sort(survivors.begin(), survivors.end());
+
+            waiting.clear();
+            kept_columns = 0;
+            for (unsigned i = 0; i < survivors.size(); i++) {
+                const auto [k, list] = survivors[i];
+                waiting.insert(k, list);
+                if ((k >> 32) != col && (i == 0 || (survivors[i - 1].first >> 32) != (k >> 32))) {
+                    kept_columns++;
+                }
+            }
+
+            collection = std::max(2 * kept, MIN_COLLECTION);
+        }
+
+        // processes column <col>, whose input starts at <input>, and moves on to the next
+        inline bool step(const Terminal *input, std::size_t available) {
+            process(input, available);
+            advance();
+            return isViable();
+        }
+
+        // returns false once the input read so far is no prefix of a sentence
+        bool feed(const String &chunk) {
+            if (finished || !isViable()) {
+                return false;
+            }
+
+            // a column only needs the terminals of its window, which are dropped once
+            // it is processed; the columns of the buffered terminals read on into the
+            // chunk, the others are processed where they are in the chunk
+            const std::size_t window = ahead.size();
+            if (!buffered.empty()) {
+                const std::size_t carried = buffered.size();
+                buffered.insert(buffered.end(), chunk.begin(), chunk.begin() + std::min(chunk.size(), window - 1));
+
+                std::size_t i = 0;
+                for (; i < carried && i + window <= buffered.size(); i++) {
+                    if (!step(&buffered[i], buffered.size() - i)) {
+                        return false;
+                    }
+                }
+                if (i < carried) { // the chunk is too short to finish them, and buffered whole
+                    buffered.erase(buffered.begin(), buffered.begin() + i);
+                    return true;
+                }
+                buffered.clear();
+            }
+
+            std::size_t i = 0;
+            for (; i + window <= chunk.size(); i++) {
+                if (!step(&chunk[i], chunk.size() - i)) {
+                    return false;
+                }
+            }
+            buffered.assign(chunk.begin() + i, chunk.end());
+
+            return true;
+        }
+
+        bool finish() {
+            if (finished || !isViable()) {
+                finished = true;
+                return false;
+            }
+
+            finished = true;
+            for (std::size_t i = 0; i < buffered.size(); i++) {
+                if (!step(&buffered[i], buffered.size() - i)) {
+                    return false;
+                }
+            }
+            process(nullptr, 0);
+            return known.find({ 0, grammar->getRootRule(), 1 }) != nullptr;
+        }
+    };
+
+    struct EarleyParser::Recognizer::State : RecognizerState {};
+
+    EarleyParser::Recognizer::Recognizer(const EarleyParser *parser) : state(std::make_unique<State>()) {
+        state->reset(parser->grammar);
+    }
+
+    EarleyParser::Recognizer::Recognizer(Recognizer &&) = default;
+    EarleyParser::Recognizer &EarleyParser::Recognizer::operator = (Recognizer &&) = default;
+    EarleyParser::Recognizer::~Recognizer() = default;
+
+    bool EarleyParser::Recognizer::feed(const String &chunk) {
+        return state->feed(chunk);
+    }
+
+    bool EarleyParser::Recognizer::isViablePrefix() const {
+        return !state->finished && state->isViable();
+    }
+
+    bool EarleyParser::Recognizer::finish() {
+        return state->finish();
+    }
+
+    std::size_t EarleyParser::Recognizer::getLiveColumns() const {
+        return state->liveColumns();
+    }
+
+    std::size_t EarleyParser::Recognizer::getPeakColumns() const {
+        return state->peak;
+    }
+
+    struct ParseWorkspace::Recognition : RecognizerState {};
+
+    ParseWorkspace::ParseWorkspace() {}
+
+    ParseWorkspace::ParseWorkspace(ParseWorkspace &&) = default;
+    ParseWorkspace &ParseWorkspace::operator = (ParseWorkspace &&) = default;
+    ParseWorkspace::~ParseWorkspace() = default;
+
+    EarleyParser::EarleyParser() {}
+
+    void EarleyParser::initGrammar(const std::string &filename) {
+        if (GrammarImage::isImage(filename)) {
+            const GrammarImage image(filename);
+            gm = image.getGrammar();
+            grammar = image.getCompiledGrammar(gm);
+        } else {
+            gm.parseFromFile(filename);
+            grammar = std::make_shared<const CompiledGrammar>(gm);
+        }
+
+        if (trace && trace->enabled(TraceLevel::GRAMMAR)) {
+            trace->write(TraceLevel::GRAMMAR, gm.debugInfo());
+        }
+    }
+
+    // the tree is only built if it, the table or the steps are traced
+    bool EarleyParser::parseInput(const String &input, ParseWorkspace &workspace) const {
+        if (trace && (trace->enabled(TraceLevel::TABLE) || trace->enabled(TraceLevel::TREE) || trace->enabled(TraceLevel::STEP))) {
+            return parseTree(input).first;
+        }
+        return accepts(input, workspace);
+    }
+
+    bool EarleyParser::accepts(const String &input) const {
+        ParseWorkspace workspace;
+        return accepts(input, workspace);
+    }
+
+    bool EarleyParser::accepts(const String &input, ParseWorkspace &workspace) const {
+        if (!workspace.recognition) {
+            workspace.recognition = std::make_unique<ParseWorkspace::Recognition>();
+        }
+
+        RecognizerState &recognizer = *workspace.recognition;
+        recognizer.reset(grammar);
+        return recognizer.feed(input) && recognizer.finish();
+    }
+
+    std::pair<bool, ProductionTree> EarleyParser::parseTree(const String &input, ParseStatistics *statistics) const {
+        const CompiledGrammar &cg = *grammar;
+
+        const auto recognizeStart = std::chrono::steady_clock::now();
+
+        const Table DP = recognize(cg, input, trace);
+
+        if (statistics) {
+            statistics->recognizeTime = std::chrono::steady_clock::now() - recognizeStart;
+            statistics->columns = DP.size();
+            statistics->items = statistics->maxColumnSize = 0;
+            for (const Column &column : DP) {
+                statistics->items += column.size();
+                statistics->maxColumnSize = std::max(statistics->maxColumnSize, column.size());
+            }
+        }
+
+        return buildTree(grammar, DP, input, gm, trace);
+    }
+
+    SyntaxTree EarleyParser::parseSyntaxTree(const String &input) const {
+        const CompiledGrammar &cg = *grammar;
+
+        const Table DP = recognize(cg, input, trace);
+
+        if (trace && trace->enabled(TraceLevel::TABLE)) {
+            trace->write(TraceLevel::TABLE, printTable(cg, DP, input));
+        }
+
+        return buildSyntaxTree(grammar, DP, input);
+    }
+
+    EarleyParser::Recognizer EarleyParser::startRecognizer() const {
+        return Recognizer(this);
+    }
+
+    EarleyParser::Session EarleyParser::startSession() {
+        return Session(this);
+    }
+
+    EarleyParser::Document EarleyParser::openDocument() {
+        return Document(this);
+    }
+
+    ParseForest EarleyParser::parseForest(const String &input) const {
+        const CompiledGrammar &cg = *grammar;
+
+        const Table DP = recognize(cg, input, trace);
+
+        if (trace && trace->enabled(TraceLevel::TABLE)) {
+            trace->write(TraceLevel::TABLE, printTable(cg, DP, input));
+        }
+
+        const EarleyItem *root = findRoot(cg, DP.back());
+        if (!root) {
+            return ParseForest();
+        }
+
+        ForestBuilder builder(cg, DP, input);
+        const unsigned forest_root = builder.build(*root);
+        return ParseForest(grammar, std::move(builder.getNodes()), forest_root);
+    }
+
+    // whether a node of a tree that doesn't tell its rule was derived by a *> rule; the
+    // classes of a rule show in the tree as the characters they matched
+    static bool resolvesFully(const CompiledGrammar &cg, const ProductionTree &tree) {
+        if (tree.from >= cg.getNonterminalCount()) {
+            return false;
+        }
+
+        const auto [first, last] = cg.getRange(tree.from);
+        for (unsigned r = first; r < last; r++) {
+            const Rule &rule = cg.getRule(r);
+            if (cg.isFullResolve(r) && rule.size() == tree.rule.size() &&
+                    std::equal(rule.begin(), rule.end(), tree.rule.begin(), [&cg] (const Symbol &s, const Symbol &matched) {
+                        return s == matched || (s.cls != NO_CLASS && matched.isTerminal && matched.cls == NO_CLASS &&
+                            matched.literal == NO_LITERAL && cg.matches(s, matched.t));
+                    })) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    ProductionTree EarleyParser::refineTree(const ProductionTree &tree) const {
+        const CompiledGrammar &cg = *grammar;
+        ProductionTree result = tree;
+
+        // children before their parents, in place
+        std::vector<std::pair<ProductionTree *, bool>> stack{ { &result, false } };
+        while (!stack.empty()) {
+            const auto [current, visited] = stack.back();
+            stack.pop_back();
+
+            if (visited) {
+                cg.refineNode(*current, resolvesFully(cg, *current));
+                continue;
+            }
+
+            stack.push_back({ current, true });
+            for (ProductionTree &subtree : current->subtrees) {
+                if (cg.isCleared(subtree.from)) {
+                    subtree.rule.clear();
+                    subtree.subtrees.clear();
+                } else {
+                    stack.push_back({ &subtree, false });
+                }
+            }
+        }
+
+        return result;
+    }
+
+    void EarleyParser::writeTree(std::ostream &out, const ProductionTree &tree, TreeFormat format) const {
+        gm.writeTree(out, tree, format);
     }
 
-} // namespace cfg
\ No newline at end of file
+} // namespace cfg
@@ -4,10 +4,10 @@
 #include <cstdlib>
 #include <deque>
 #include <fstream>
-#include <functional>
 #include <sstream>
 
 #include "Grammar.hpp"
+#include "MappedFile.hpp"
 
 // temporary
 #include <iostream>
@@ -16,12 +16,10 @@ namespace cfg {
 
     static const std::tuple<Token::Type, Nonterminal, Rule, char> FAIL_RULE = { Token::Type::ARROW, UINT_MAX, {}, '\0' };
 
-    static bool containsNoCode(const std::string &line) {
-        static const std::string WHITESPACE = " \t";
-
-        for (unsigned i = 0; i < line.length(); i++) {
-            if (line.at(i) == '#') { return true; }
-            if (WHITESPACE.find_first_of(line.at(i)) == std::string::npos) { return false; }
+    static bool containsNoCode(std::string_view line) {
+        for (const char c : line) {
+            if (c == '#') { return true; }
+            if (c != ' ' && c != '\t') { return false; }
         }
         return true;
     }
@@ -31,69 +29,228 @@ namespace cfg {
         res.resize(s.length());
 
         for (unsigned i = 0; i < s.length(); i++) {
-            res.at(i) = s.at(i);
+            res.at(i) = static_cast<unsigned char>(s.at(i));
         }
 
         return res;
     }
 
-    const std::string GrammarManager::START_SYMBOL = "S";
+    CharacterClass parseClass(std::string_view text) {
+        CharacterClass set;
+        if (text == ".") {
+            return set.set();
+        }
 
-    std::map<Nonterminal, bool> getTerminateMap(const Grammar &g) {
+        const std::string_view body = text.substr(1, text.length() - 2);
+        unsigned i = body.front() == '^' ? 1 : 0;
 
-        std::map<Nonterminal, bool> called, known, termination_map;
-        for (const auto &it : g) {
-            called[it.first] = known[it.first] = termination_map[it.first] = false;
+        // the next character of the class, escapes resolved the way strings do
+        auto next = [&] () -> unsigned char {
+            if (body.at(i) != '\\') {
+                return body.at(i++);
+            }
+            i += 2;
+            switch (body.at(i - 1)) {
+                case 'n': return '\n';
+                case 't': return '\t';
+                default:  return body.at(i - 1);
+            }
+        };
+
+        while (i < body.length()) {
+            const unsigned char low = next();
+            unsigned char high = low;
+            if (i + 1 < body.length() && body.at(i) == '-') {
+                i++;
+                high = next();
+                if (high < low) {
+                    throw std::runtime_error("Invalid range in character class '" + std::string(text) + "'.");
+                }
+            }
+            for (unsigned c = low; c <= high; c++) {
+                set.set(c);
+            }
         }
 
-        std::function<bool(const Symbol &s)> term = [&] (const Symbol &s) -> bool {
-            if (s.isTerminal) { return true; }
+        return body.front() == '^' ? ~set : set;
+    }
+
+    std::string classToString(const CharacterClass &set) {
+        if (set.all()) {
+            return ".";
+        }
 
-            Nonterminal n = s.n;
+        auto ranges = [] (const CharacterClass &set) -> std::string {
+            auto print = [] (unsigned c) -> std::string {
+                switch (c) {
+                    case '\n': return "\\n";
+                    case '\t': return "\\t";
+                    case '\\': case ']': case '-': case '^': return std::string("\\") + char(c);
+                    default:   return std::string(1, char(c));
+                }
+            };
+
+            std::string res;
+            for (unsigned c = 0; c < set.size(); c++) {
+                if (!set.test(c)) {
+                    continue;
+                }
+                unsigned end = c;
+                while (end + 1 < set.size() && set.test(end + 1)) {
+                    end++;
+                }
+                res += print(c);
+                if (end > c) {
+                    res += (end > c + 1 ? "-" : "") + print(end);
+                }
+                c = end;
+            }
+            return res;
+        };
+
+        const std::string direct = ranges(set), complement = ranges(~set);
+        return complement.length() < direct.length() ? "[^" + complement + "]" : "[" + direct + "]";
+    }
+
+    const std::string GrammarManager::START_SYMBOL = "S";
+
+    // least fixed point: a nonterminal terminates once one of its rules consists of
+    // terminals and terminating nonterminals only. every rule counts its nonterminals not
+    // known to terminate yet, and a queue of the newly terminating ones counts them down,
+    // so long chains of nonterminals cost neither quadratic time nor deep recursion
+    std::map<Nonterminal, bool> getTerminateMap(const Grammar &g) {
+        std::map<Nonterminal, bool> termination_map;
+        if (g.empty()) {
+            return termination_map;
+        }
 
-            if (called.at(n)) { return false; }
-            if (known.at(n)) { return termination_map.at(n); }
+        const Nonterminal bound = g.rbegin()->first + 1;
+        std::vector<bool> terminates(bound, false);
+        std::vector<std::pair<Nonterminal, unsigned>> pending; // per rule: its nonterminal and the count
+        std::vector<std::vector<unsigned>> occurrences(bound); // per nonterminal: a rule for each occurrence
+        std::vector<Nonterminal> queue;
 
-            termination_map.at(n) = false;
-            called.at(n) = true;
+        auto found = [&] (Nonterminal n) {
+            if (!terminates[n]) {
+                terminates[n] = true;
+                queue.push_back(n);
+            }
+        };
 
-            for (const Rule &rule : g.at(n)) {
-                bool success = true;
-                for (const Symbol &sym : rule) {
-                    if (!term(sym)) {
-                        success = false;
-                        break;
+        for (const auto &it : g) {
+            termination_map[it.first] = false;
+            for (const Rule &rule : it.second) {
+                unsigned count = 0;
+                for (const Symbol &s : rule) {
+                    if (!s.isTerminal) {
+                        count++;
+                        if (s.n < bound) { // undefined nonterminals never terminate
+                            occurrences[s.n].push_back(pending.size());
+                        }
                     }
                 }
+                pending.push_back({ it.first, count });
+                if (count == 0) {
+                    found(it.first);
+                }
+            }
+        }
+
+        while (!queue.empty()) {
+            const Nonterminal n = queue.back();
+            queue.pop_back();
+            termination_map.at(n) = true;
 
-                if (success) {
-                    termination_map.at(n) = true;
-                    break;
+            for (unsigned r : occurrences[n]) {
+                if (--pending[r].second == 0) {
+                    found(pending[r].first);
                 }
             }
+        }
 
-            known.at(n) = true;
-            called.at(n) = false;
-            return termination_map.at(n);
-        };
+        return termination_map;
+    }
+
+    RuleTable getRuleTable(const Grammar &g) {
+        RuleTable table;
+
+        if (!g.empty()) {
+            table.ranges.resize(g.rbegin()->first + 1, { 0, 0 });
+        }
 
         for (const auto &it : g) {
-            term({ false, { .n = it.first } });
+            const unsigned first = table.rules.size();
+            for (const Rule &r : it.second) {
+                table.from.push_back(it.first);
+                table.rules.push_back(r);
+            }
+            table.ranges.at(it.first) = { first, table.rules.size() };
         }
 
-        return termination_map;
+        return table;
     }
 
-    Nonterminal GrammarManager::addNonterminal(const std::string &name) {
-        if (nonterminal_index_map.find(name) != nonterminal_index_map.end()) {
-            return nonterminal_index_map.at(name);
-        } else {
-            nonterminal_index_map[name] = nonterminal_maxindex;
-            return nonterminal_maxindex++;
+    void GrammarManager::nameNonterminal(std::string_view name, Nonterminal n) {
+        nonterminal_index_map.emplace(name, n);
+        if (n >= nonterminal_names.size()) {
+            nonterminal_names.resize(n + 1);
+        }
+        nonterminal_names[n] = name;
+    }
+
+    // CONTRACT: <t> is a token, at least CHARACTERS
+    void GrammarManager::nameToken(std::string_view name, Terminal t) {
+        token_index_map.emplace(name, t);
+        if (t - CHARACTERS >= token_names.size()) {
+            token_names.resize(t - CHARACTERS + 1);
+        }
+        token_names[t - CHARACTERS] = name;
+    }
+
+    Nonterminal GrammarManager::addNonterminal(std::string_view name) {
+        const auto it = nonterminal_index_map.find(name);
+        if (it != nonterminal_index_map.end()) {
+            return it->second;
+        }
+        nameNonterminal(name, nonterminal_maxindex);
+        return nonterminal_maxindex++;
+    }
+
+    Terminal GrammarManager::addToken(std::string_view name) {
+        const auto it = token_index_map.find(name);
+        if (it != token_index_map.end()) {
+            return it->second;
+        }
+        nameToken(name, token_maxindex);
+        return token_maxindex++;
+    }
+
+    Terminal GrammarManager::getToken(const std::string &name) const {
+        const auto it = token_index_map.find(name);
+        if (it == token_index_map.end()) {
+            throw std::runtime_error("Unknown Token '@" + name + "'.");
         }
+        return it->second;
     }
 
-    std::vector<std::tuple<Token::Type, Nonterminal, Rule, char>> GrammarManager::parseProductionRule(const std::string &line) {
+    unsigned GrammarManager::addLiteral(const String &run) {
+        const auto [it, added] = literal_index_map.emplace(run, literals.size());
+        if (added) {
+            literals.push_back(run);
+        }
+        return it->second;
+    }
+
+    unsigned GrammarManager::addClass(const CharacterClass &set) {
+        const auto known = std::find(classes.begin(), classes.end(), set);
+        if (known != classes.end()) {
+            return known - classes.begin();
+        }
+        classes.push_back(set);
+        return classes.size() - 1;
+    }
+
+    std::vector<std::tuple<Token::Type, Nonterminal, Rule, char>> GrammarManager::parseProductionRule(std::string_view line) {
         std::vector<Token> tokens = lex(line);
         std::size_t index = 0;
 
@@ -140,7 +297,7 @@ namespace cfg {
 
                 std::vector<Token> symbol_tokens;
                 while (inBounds() && peek().type != Token::Type::PIPE) {
-                    symbol_tokens.push_back(select(2, Token::Type::NONTERMINAL, Token::Type::STRING));
+                    symbol_tokens.push_back(select(4, Token::Type::NONTERMINAL, Token::Type::STRING, Token::Type::CLASS, Token::Type::TOKEN));
                 }
 
                 if (inBounds() && peek().type == Token::Type::PIPE) {
@@ -150,9 +307,17 @@ namespace cfg {
                 std::vector<Symbol> rule_production;
                 for (const Token &t : symbol_tokens) {
                     if (t.type == Token::Type::STRING) {
-                        for (unsigned i = 0; i < t.text.length(); i++) {
-                            rule_production.push_back({ true, { .t = t.text.at(i) } });
+                        // a string of several characters becomes a single literal terminal
+                        const String run = toTerminals(unescape(t.text));
+                        if (run.size() == 1) {
+                            rule_production.push_back({ true, { .t = run.front() } });
+                        } else if (run.size() > 1) {
+                            rule_production.push_back({ true, { .t = run.front() }, NO_CLASS, addLiteral(run) });
                         }
+                    } else if (t.type == Token::Type::CLASS) {
+                        rule_production.push_back({ true, { .t = '\0' }, addClass(parseClass(t.text)) });
+                    } else if (t.type == Token::Type::TOKEN) {
+                        rule_production.push_back({ true, { .t = addToken(t.text) } });
                     } else { // Token::Type::NONTERMINAL
                         rule_production.push_back({ false, { .n = addNonterminal(t.text) } });
                     }
@@ -170,21 +335,44 @@ namespace cfg {
     }
 
     std::string GrammarManager::getNonterminalName(Nonterminal n) const {
-        for (const auto &it : nonterminal_index_map) {
-            if (it.second == n) { return it.first; }
+        if (n < nonterminal_names.size() && !nonterminal_names[n].empty()) {
+            return nonterminal_names[n];
         }
         return std::to_string(n);
     }
 
+    std::string GrammarManager::getTerminalName(const Symbol &s) const {
+        if (s.cls != NO_CLASS) {
+            return classToString(classes.at(s.cls));
+        } else if (s.literal != NO_LITERAL) {
+            return std::string(literals.at(s.literal).begin(), literals.at(s.literal).end());
+        } else if (s.t < CHARACTERS) {
+            return std::string(1, char(s.t));
+        }
+        if (s.t - CHARACTERS < token_names.size() && !token_names[s.t - CHARACTERS].empty()) {
+            return "@" + token_names[s.t - CHARACTERS];
+        }
+        return "@" + std::to_string(s.t);
+    }
+
     void GrammarManager::reset() {
         g.clear();
         fullresolveRules.clear();
+        classes.clear();
+        literals.clear();
+        literal_index_map.clear();
 
         clearProductions.clear();
         deleteProductions.clear();
 
-        nonterminal_index_map[START_SYMBOL] = 0;
+        nonterminal_index_map.clear();
+        nonterminal_names.clear();
+        nameNonterminal(START_SYMBOL, S);
         nonterminal_maxindex = 1;
+
+        token_index_map.clear();
+        token_names.clear();
+        token_maxindex = CHARACTERS;
     }
 
     GrammarManager::GrammarManager() {
@@ -201,16 +389,28 @@ namespace cfg {
     GrammarManager::GrammarManager(const GrammarManager &other) {
         g = other.g;
         fullresolveRules = other.fullresolveRules;
+        classes = other.classes;
+        literals = other.literals;
+        literal_index_map = other.literal_index_map;
 
         nonterminal_index_map = other.nonterminal_index_map;
+        nonterminal_names = other.nonterminal_names;
         nonterminal_maxindex = other.nonterminal_maxindex;
+
+        token_index_map = other.token_index_map;
+        token_names = other.token_names;
+        token_maxindex = other.token_maxindex;
     }
 
     void GrammarManager::parse(const std::vector<std::string> &lines) {
+        parseLines(std::vector<std::string_view>(lines.begin(), lines.end()));
+    }
+
+    void GrammarManager::parseLines(const std::vector<std::string_view> &lines) {
         reset();
 
         unsigned line_number = 1;
-        for (std::string line : lines) {
+        for (std::string_view line : lines) {
             if (containsNoCode(line)) {
                 continue;
             }
@@ -251,68 +451,33 @@ namespace cfg {
     }
 
     void GrammarManager::parseFromFile(const std::string &filename) {
-        std::fstream file(filename);
+        const MappedFile file(filename);
 
-        if (!file) {
+        if (!file.isOpen()) {
             return;
         }
 
-        std::vector<std::string> lines;
-        std::string tmp;
-        while (!file.eof()) {
-            std::getline(file, tmp);
-            lines.push_back(tmp);
+        // the lines are views into the mapping, without their line breaks
+        const std::string_view contents = file.contents();
+        std::vector<std::string_view> lines;
+        for (std::size_t begin = 0; begin < contents.length(); ) {
+            std::size_t end = contents.find('\n', begin);
+            if (end == std::string_view::npos) {
+                end = contents.length();
+            }
+            std::string_view line = contents.substr(begin, end - begin);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            lines.push_back(line);
+            begin = end + 1;
         }
 
-        parse(lines);
+        parseLines(lines);
     }
 
     bool GrammarManager::terminates() {
-        std::map<Nonterminal, bool> known, called;
-
-        termination_map.clear();
-
-        for (const auto &rule : g) {
-            known[rule.first] = false;
-            called[rule.first] = false;
-            termination_map[rule.first] = false;
-        }
-
-        std::function<bool(Symbol)> term = [&] (Symbol s) -> bool {
-            if (s.isTerminal) { return true; }
-
-            Nonterminal n = s.n;
-
-            if (called.at(n)) { return false; }
-            if (known.at(n)) { return termination_map.at(n); }
-
-            termination_map.at(n) = false;
-            called.at(n) = true;
-
-            for (const Rule &rule : g.at(n)) {
-                bool success = true;
-                for (const Symbol &sym : rule) {
-                    if (!term(sym)) {
-                        success = false;
-                        break;
-                    }
-                }
-
-                if (success) {
-                    termination_map.at(n) = true;
-                    break;
-                }
-            }
-
-            known.at(n) = true;
-            called.at(n) = false;
-            return termination_map.at(n);
-        };
-
-        for (auto &it : g) {
-            term({ false, { .n = it.first } });
-        }
-
+        termination_map = getTerminateMap(g);
         return termination_map.at(S);
     }
 
@@ -334,88 +499,9 @@ namespace cfg {
         }
     }
 
-    ProductionTree GrammarManager::refineTree(const ProductionTree &tree) {        
-        ProductionTree tmp = { tree.from, tree.rule, std::vector<ProductionTree>{} };
-
-        for (const ProductionTree &t : tree.subtrees) {
-            if (clearProductions.find(t.from) != clearProductions.end() ||
-                    deleteProductions.find(t.from) != deleteProductions.end()) {
-                tmp.subtrees.push_back(ProductionTree{ t.from, Rule{}, std::vector<ProductionTree>{} });
-            } else {
-                tmp.subtrees.push_back(refineTree(t));
-            }
-        }
-        
-        ProductionTree res = { tmp.from, Rule{}, std::vector<ProductionTree>{} };
-
-        if (fullresolveRules.find(tmp.from) != fullresolveRules.end() &&
-                contains(fullresolveRules.at(tmp.from), tmp.rule)) {
-            unsigned subtree_i = 0;
-            for (const Symbol &s : tmp.rule) {
-                if (s.isTerminal) {
-                    res.rule.push_back(s);
-                } else {
-                    const ProductionTree &subtree = tmp.subtrees.at(subtree_i++);
-                    res.rule.insert(res.rule.end(), subtree.rule.begin(), subtree.rule.end());
-                    res.subtrees.insert(res.subtrees.end(), subtree.subtrees.begin(), subtree.subtrees.end());
-                }
-            }
-        } else {
-            res = tmp;
-        }
-
-        tmp = res;
-        res = { tmp.from, Rule{}, std::vector<ProductionTree>{} };
-
-        unsigned subtree_i = 0;
-        for (const Symbol &s : tmp.rule) {
-            if (s.isTerminal) {
-                res.rule.push_back(s);
-            } else {
-                if (deleteProductions.find(s.n) == deleteProductions.end()) {
-                    res.rule.push_back(s);
-                    res.subtrees.push_back(tmp.subtrees.at(subtree_i));
-                }
-                subtree_i++;
-            }
-        }
-
-        return res;
-    }
-
-    std::string GrammarManager::printTree(const ProductionTree &tree, const std::string indent) {
+    std::string GrammarManager::printTree(const ProductionTree &tree) const {
         std::stringstream stream;
-
-        stream << indent << getNonterminalName(tree.from) << " -> ";
-        if (tree.rule.empty()) {
-            stream << "€";
-        } else {
-            stream << "'";
-            for (const Symbol &s : tree.rule) {
-                if (s.isTerminal) {
-                    stream << "\033[31m" << s.t << "\033[0m";
-                } else {
-                    stream << "<" << getNonterminalName(s.n) << ">";
-                }
-            }
-            stream << "'";
-        }
-
-        stream << ":\n";
-        
-        unsigned subtree_ptr = 0;
-        for (const Symbol &s : tree.rule) {
-            if (s.isTerminal) {
-                stream << indent << s.t << '\n';
-            } else {
-                if (subtree_ptr < tree.subtrees.size()) {
-                    stream << printTree(tree.subtrees.at(subtree_ptr++), indent + "    ");
-                } else {
-                    stream << indent << "    <missing tree!!>\n";
-                }
-            }
-        }
-
+        writeTree(stream, tree, TreeFormat::TEXT);
         return stream.str();
     }
 
@@ -432,7 +518,7 @@ namespace cfg {
                 } else {
                     for (const Symbol &s : r) {
                         if (s.isTerminal) {
-                            stream << "\033[31;3m" << s.t << "\033[0m";
+                            stream << "\033[31;3m" << getTerminalName(s) << "\033[0m";
                         } else {
                             stream << "[" << s.n << ": " << getNonterminalName(s.n) << "]";
                         }
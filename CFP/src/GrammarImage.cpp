@@ -0,0 +1,378 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "GrammarImage.hpp"
+
+namespace cfg {
+
+    static constexpr char MAGIC[8] = { 'C', 'F', 'G', 'I', 'M', 'A', 'G', 'E' };
+    static constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    struct ImageHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        std::uint64_t sections[GrammarImage::SECTIONS][2]; // offset and size in bytes, from the start of the file
+    };
+
+    static constexpr std::uint32_t FULL_RESOLVE = 1; // rule flag: the rule was given with *>
+
+    [[noreturn]] static void fail(const std::string &what) {
+        throw std::runtime_error("Invalid Grammar Image: " + what + ".");
+    }
+
+    static void writeWide(std::vector<std::uint32_t> &words, std::uint64_t wide) {
+        words.push_back(static_cast<std::uint32_t>(wide));
+        words.push_back(static_cast<std::uint32_t>(wide >> 32));
+    }
+
+    // the length, followed by the characters padded to whole words
+    static void writeText(std::vector<std::uint32_t> &words, std::string_view text) {
+        words.push_back(text.length());
+        const std::size_t start = words.size();
+        words.resize(start + (text.length() + 3) / 4, 0);
+        std::memcpy(words.data() + start, text.data(), text.length());
+    }
+
+    // reads the words of a section front to back, checking every read against its end
+    class ImageReader {
+
+    private:
+
+        const char *pos, *end;
+
+    public:
+
+        ImageReader(std::string_view section) : pos(section.data()), end(section.data() + section.size()) {}
+
+        inline std::uint32_t word() {
+            if (end - pos < 4) {
+                fail("section ends early");
+            }
+            std::uint32_t word;
+            std::memcpy(&word, pos, 4);
+            pos += 4;
+            return word;
+        }
+
+        inline std::uint64_t wide() {
+            const std::uint64_t low = word();
+            return low | std::uint64_t{ word() } << 32;
+        }
+
+        // a word below <bound>
+        inline std::uint32_t below(std::uint32_t bound, const char *what) {
+            const std::uint32_t value = word();
+            if (value >= bound) {
+                fail(std::string(what) + " out of range");
+            }
+            return value;
+        }
+
+        // the number of the elements that follow, each of at least <size> words, so
+        // that a damaged count can't make the reader allocate more than the file holds
+        inline std::uint32_t count(std::size_t size = 1) {
+            const std::uint32_t count = word();
+            if (count > std::size_t(end - pos) / (4 * size)) {
+                fail("count beyond the end of the section");
+            }
+            return count;
+        }
+
+        inline std::string_view text() {
+            const std::uint32_t length = word();
+            if ((length + std::size_t{ 3 }) / 4 * 4 > std::size_t(end - pos)) {
+                fail("section ends early");
+            }
+            const std::string_view text(pos, length);
+            pos += (length + 3) / 4 * 4;
+            return text;
+        }
+    };
+
+    void GrammarImage::writeGrammar(std::vector<std::uint32_t> &words, const GrammarManager &gm) {
+        words.push_back(gm.nonterminal_maxindex);
+        words.push_back(gm.token_maxindex);
+
+        words.push_back(gm.nonterminal_index_map.size());
+        for (const auto &[name, n] : gm.nonterminal_index_map) {
+            words.push_back(n);
+            writeText(words, name);
+        }
+        words.push_back(gm.token_index_map.size());
+        for (const auto &[name, t] : gm.token_index_map) {
+            words.push_back(t);
+            writeText(words, name);
+        }
+
+        words.push_back(gm.classes.size());
+        for (const CharacterClass &cls : gm.classes) {
+            for (unsigned word = 0; word < CHARACTERS / 32; word++) {
+                std::uint32_t bits = 0;
+                for (unsigned bit = 0; bit < 32; bit++) {
+                    bits |= std::uint32_t{ cls.test(word * 32 + bit) } << bit;
+                }
+                words.push_back(bits);
+            }
+        }
+
+        words.push_back(gm.literals.size());
+        for (const String &literal : gm.literals) {
+            words.push_back(literal.size());
+            words.insert(words.end(), literal.begin(), literal.end());
+        }
+
+        words.push_back(gm.g.size());
+        for (const auto &[from, rules] : gm.g) {
+            const auto full = gm.fullresolveRules.find(from);
+            words.push_back(from);
+            words.push_back(rules.size());
+            for (const Rule &rule : rules) {
+                words.push_back(full != gm.fullresolveRules.end() && contains(full->second, rule) ? FULL_RESOLVE : 0);
+                words.push_back(rule.size());
+                for (const Symbol &s : rule) {
+                    words.insert(words.end(), { s.isTerminal, s.isTerminal ? s.t : s.n, s.cls, s.literal });
+                }
+            }
+        }
+
+        for (const auto *productions : { &gm.clearProductions, &gm.deleteProductions }) {
+            words.push_back(productions->size());
+            for (const auto &it : *productions) {
+                words.push_back(it.first);
+            }
+        }
+    }
+
+    GrammarManager GrammarImage::readGrammar(std::string_view section) {
+        ImageReader reader(section);
+        GrammarManager gm;
+
+        gm.nonterminal_maxindex = reader.word();
+        gm.token_maxindex = reader.word();
+        if (gm.token_maxindex < CHARACTERS) {
+            fail("alphabet smaller than the characters");
+        }
+
+        gm.nonterminal_index_map.clear();
+        gm.nonterminal_names.clear();
+        for (std::uint32_t i = reader.count(2); i > 0; i--) {
+            const Nonterminal n = reader.below(gm.nonterminal_maxindex, "nonterminal");
+            gm.nameNonterminal(reader.text(), n);
+        }
+        for (std::uint32_t i = reader.count(2); i > 0; i--) {
+            const Terminal t = reader.below(gm.token_maxindex, "token");
+            if (t < CHARACTERS) {
+                fail("token out of range");
+            }
+            gm.nameToken(reader.text(), t);
+        }
+
+        gm.classes.resize(reader.count(CHARACTERS / 32));
+        for (CharacterClass &cls : gm.classes) {
+            for (unsigned word = 0; word < CHARACTERS / 32; word++) {
+                const std::uint32_t bits = reader.word();
+                for (unsigned bit = 0; bit < 32; bit++) {
+                    cls.set(word * 32 + bit, bits >> bit & 1);
+                }
+            }
+        }
+
+        gm.literals.resize(reader.count());
+        for (String &literal : gm.literals) {
+            literal.resize(reader.count());
+            for (Terminal &t : literal) {
+                t = reader.below(gm.token_maxindex, "terminal");
+            }
+            if (literal.empty()) {
+                fail("empty literal");
+            }
+        }
+
+        std::vector<bool> defined(gm.nonterminal_maxindex, false);
+        Nonterminal previous = 0;
+        for (std::uint32_t i = reader.count(2); i > 0; i--) {
+            const Nonterminal from = reader.below(gm.nonterminal_maxindex, "nonterminal");
+            if (!gm.g.empty() && from <= previous) {
+                fail("rules out of order");
+            }
+            previous = from;
+            defined[from] = true;
+
+            std::vector<Rule> &rules = gm.g.emplace_hint(gm.g.end(), from, std::vector<Rule>{})->second;
+            rules.resize(reader.count(2));
+            for (Rule &rule : rules) {
+                const std::uint32_t flags = reader.word();
+                rule.resize(reader.count(4));
+                for (Symbol &s : rule) {
+                    s.isTerminal = reader.below(2, "symbol kind");
+                    if (s.isTerminal) {
+                        s.t = reader.below(gm.token_maxindex, "terminal");
+                    } else {
+                        s.n = reader.below(gm.nonterminal_maxindex, "nonterminal");
+                    }
+                    s.cls = reader.word();
+                    s.literal = reader.word();
+                    if ((s.cls != NO_CLASS && (!s.isTerminal || s.cls >= gm.classes.size())) ||
+                            (s.literal != NO_LITERAL && (!s.isTerminal || s.literal >= gm.literals.size() || gm.literals[s.literal].front() != s.t))) {
+                        fail("symbol with an unknown class or literal");
+                    }
+                }
+                if (flags & FULL_RESOLVE) {
+                    gm.fullresolveRules[from].push_back(rule);
+                }
+            }
+        }
+
+        for (auto *productions : { &gm.clearProductions, &gm.deleteProductions }) {
+            for (std::uint32_t i = reader.count(); i > 0; i--) {
+                (*productions)[reader.below(gm.nonterminal_maxindex, "nonterminal")] = 0;
+            }
+        }
+
+        // the parsers look up the rules of every nonterminal they meet
+        if (gm.nonterminal_maxindex == S || !defined[S]) {
+            fail("no rules for the start symbol");
+        }
+        for (const auto &it : gm.g) {
+            for (const Rule &rule : it.second) {
+                for (const Symbol &s : rule) {
+                    if (!s.isTerminal && !defined[s.n]) {
+                        fail("undefined nonterminal");
+                    }
+                }
+            }
+        }
+
+        return gm;
+    }
+
+    GrammarImage::GrammarImage(const std::string &filename) : file(filename) {
+        if (!file.isOpen()) {
+            throw std::runtime_error("Can't open grammar image '" + filename + "'.");
+        }
+
+        const std::string_view contents = file.contents();
+        ImageHeader header;
+        if (contents.size() < sizeof header) {
+            fail("file ends within the header");
+        }
+        std::memcpy(&header, contents.data(), sizeof header);
+
+        if (std::memcmp(header.magic, MAGIC, sizeof MAGIC) != 0) {
+            fail("not a grammar image");
+        }
+        if (header.byte_order != BYTE_ORDER_MARK) {
+            fail("written on a machine of another byte order");
+        }
+        if (header.version != VERSION) {
+            fail("version " + std::to_string(header.version) + " rather than " + std::to_string(VERSION));
+        }
+
+        for (unsigned s = 0; s < SECTIONS; s++) {
+            const std::uint64_t offset = header.sections[s][0], size = header.sections[s][1];
+            if (offset > contents.size() || size > contents.size() - offset) {
+                fail("section beyond the end of the file");
+            }
+            sections[s] = contents.substr(offset, size);
+        }
+    }
+
+    GrammarManager GrammarImage::getGrammar() const {
+        return readGrammar(sections[GRAMMAR]);
+    }
+
+    GrammarManager GrammarImage::getCNF() const {
+        return hasCNF() ? readGrammar(sections[CNF]) : getGrammar().toCNF();
+    }
+
+    std::shared_ptr<const CompiledGrammar> GrammarImage::getCompiledGrammar(const GrammarManager &gm) const {
+        ImageReader reader(sections[COMPILED]);
+
+        const Nonterminal nonterminals = reader.word();
+        const Terminal alphabet = reader.word();
+        const Nonterminal expected = std::max<std::size_t>(gm.g.empty() ? 0 : gm.g.rbegin()->first + 1, gm.nonterminal_maxindex);
+        if (nonterminals != expected || alphabet != gm.token_maxindex) {
+            fail("compiled sets of another grammar");
+        }
+
+        CompiledGrammar::FixedPoints sets;
+        sets.nullable.resize(nonterminals);
+        for (Nonterminal n = 0; n < nonterminals; n += 32) {
+            const std::uint32_t bits = reader.word();
+            for (Nonterminal bit = 0; bit < 32 && n + bit < nonterminals; bit++) {
+                sets.nullable[n + bit] = bits >> bit & 1;
+            }
+        }
+
+        for (std::vector<TerminalSet> *terminal_sets : { &sets.first, &sets.follow }) {
+            terminal_sets->reserve(nonterminals);
+            for (Nonterminal n = 0; n < nonterminals; n++) {
+                std::vector<std::uint64_t> words((alphabet + 63) / 64);
+                for (std::uint64_t &word : words) {
+                    word = reader.wide();
+                }
+                terminal_sets->emplace_back(std::move(words));
+            }
+        }
+
+        return std::make_shared<const CompiledGrammar>(gm, std::move(sets));
+    }
+
+    bool GrammarImage::isImage(const std::string &filename) {
+        char magic[sizeof MAGIC];
+        std::ifstream file(filename, std::ios::binary);
+        return file.read(magic, sizeof magic) && std::memcmp(magic, MAGIC, sizeof MAGIC) == 0;
+    }
+
+    void GrammarImage::write(const GrammarManager &gm, const std::string &filename, bool cnf) {
+        std::vector<std::uint32_t> sections[SECTIONS];
+
+        writeGrammar(sections[GRAMMAR], gm);
+        if (cnf) {
+            writeGrammar(sections[CNF], gm.toCNF());
+        }
+
+        const CompiledGrammar cg(gm);
+        std::vector<std::uint32_t> &compiled = sections[COMPILED];
+        compiled.push_back(cg.getNonterminalCount());
+        compiled.push_back(cg.getAlphabetSize());
+        for (Nonterminal n = 0; n < cg.getNonterminalCount(); n += 32) {
+            std::uint32_t bits = 0;
+            for (Nonterminal bit = 0; bit < 32 && n + bit < cg.getNonterminalCount(); bit++) {
+                bits |= std::uint32_t{ cg.isNullable(n + bit) } << bit;
+            }
+            compiled.push_back(bits);
+        }
+        for (auto set : { &CompiledGrammar::getFirst, &CompiledGrammar::getFollow }) {
+            for (Nonterminal n = 0; n < cg.getNonterminalCount(); n++) {
+                for (std::uint64_t word : (cg.*set)(n).getWords()) {
+                    writeWide(compiled, word);
+                }
+            }
+        }
+
+        ImageHeader header = {};
+        std::memcpy(header.magic, MAGIC, sizeof MAGIC);
+        header.version = VERSION;
+        header.byte_order = BYTE_ORDER_MARK;
+        std::uint64_t offset = sizeof header;
+        for (unsigned s = 0; s < SECTIONS; s++) {
+            header.sections[s][0] = offset;
+            header.sections[s][1] = sections[s].size() * sizeof(std::uint32_t);
+            offset += header.sections[s][1];
+        }
+
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(&header), sizeof header);
+        for (const std::vector<std::uint32_t> &section : sections) {
+            file.write(reinterpret_cast<const char *>(section.data()), section.size() * sizeof(std::uint32_t));
+        }
+        if (!file) {
+            throw std::runtime_error("Can't write grammar image '" + filename + "'.");
+        }
+    }
+
+} // namespace cfg
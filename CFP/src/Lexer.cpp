@@ -1,77 +1,120 @@
-#include <algorithm>
-#include <regex>
-
 #include "Lexer.hpp"
 
-// temporary
-#include <iostream>
-
 namespace cfg {
 
-    static std::string cleanupString(const std::string &str) {
-        std::string res = str.substr(1, str.length() - 2);
+    static constexpr std::string_view EPSILON = "€";
 
-        for (unsigned i = 0; i < res.length(); i++) {
-            if (res.at(i) == '\\') {
-                switch (res.at(i + 1)) {
-                    case '\\': res.replace(i, 2, "\\"); break;
-                    case '\'': res.replace(i, 2, "'");  break;
-                    case '\"': res.replace(i, 2, "\""); break;
-                    case 'n':  res.replace(i, 2, "\n"); break;
-                    case 't':  res.replace(i, 2, "\t"); break;
-                }
-            }
-        }
-
-        return res;
+    static bool isWhitespace(char c) {
+        return c == ' ' || c == '\t';
     }
 
-    static bool containsOnlyWhitespace(const std::string &between_string) {
-        static const std::string WHITESPACE = " \t";
-        return std::find_if(between_string.begin(), between_string.end(),
-            [] (const char c) { return WHITESPACE.find(c) == std::string::npos; }) == between_string.end();
+    static bool isWordCharacter(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
     }
 
-    std::vector<Token> lex(const std::string &line) {
-        static const std::regex regex("((€)|(\\|)|(\\->)|(\\*>)|(\"(([^\"\\\\€]|\\\\\"|\\\\'|\\\\\\\\|\\\\n|\\\\t)*)\"|'(([^'\\\\€]|\\\\'|\\\\\"|\\\\\\\\|\\\\n|\\\\t)*)')|([\\&\\%]?\\w+)|(#[\\w\\d]*))");
-
-        std::smatch match;
+    std::vector<Token> lex(std::string_view line) {
         std::vector<Token> tokens;
 
-        std::string cur = line;
-
-        while (std::regex_search(cur, match, regex)) {
-            std::string elem = match.str();
+        auto fail = [&] (std::size_t at) {
+            throw std::runtime_error("Lexer Error at '" + std::string(line.substr(at)) + "'.");
+        };
 
-            std::string between_string = cur.substr(0, cur.find(elem));
-            if (!containsOnlyWhitespace(between_string)) {
-                throw std::runtime_error("Lexer Error at '" + between_string + "'.");
+        // the end of the word of at least one character starting at <from>
+        auto word = [&] (std::size_t from, std::size_t start) -> std::size_t {
+            std::size_t end = from;
+            while (end < line.length() && isWordCharacter(line[end])) {
+                end++;
             }
-
-            cur = match.suffix();
-
-            if (elem.at(0) == '#') { // ignore comment
-                continue;
-            } else if (elem == "€") {
-                tokens.push_back({ elem, Token::Type::EPSILON });
-            } else if (elem == "->") {
-                tokens.push_back({ elem, Token::Type::ARROW });
-            } else if (elem == "*>") {
-                tokens.push_back({ elem, Token::Type::STAR_ARROW });
-            } else if (elem == "|") {
-                tokens.push_back({ elem, Token::Type::PIPE });
-            } else if (elem.find_first_of("\"'") == std::string::npos) {
-                tokens.push_back({ elem, Token::Type::NONTERMINAL });
+            if (end == from) {
+                fail(start);
+            }
+            return end;
+        };
+
+        std::size_t i = 0;
+        while (i < line.length()) {
+            const char c = line[i];
+            const std::size_t start = i;
+
+            if (isWhitespace(c)) {
+                i++;
+            } else if (c == '#') { // comment
+                break;
+            } else if (line.compare(i, EPSILON.length(), EPSILON) == 0) {
+                i += EPSILON.length();
+                tokens.push_back({ line.substr(start, i - start), Token::Type::EPSILON });
+            } else if (c == '|') {
+                i++;
+                tokens.push_back({ line.substr(start, 1), Token::Type::PIPE });
+            } else if ((c == '-' || c == '*') && i + 1 < line.length() && line[i + 1] == '>') {
+                i += 2;
+                tokens.push_back({ line.substr(start, 2), c == '-' ? Token::Type::ARROW : Token::Type::STAR_ARROW });
+            } else if (c == '"' || c == '\'') {
+                // a string ends at the first unescaped quote of its kind
+                for (i++; i < line.length() && line[i] != c; i++) {
+                    if (line[i] == '\\') {
+                        if (i + 1 == line.length() || std::string_view("\\'\"nt").find(line[i + 1]) == std::string_view::npos) {
+                            fail(start);
+                        }
+                        i++;
+                    }
+                }
+                if (i == line.length()) {
+                    fail(start);
+                }
+                tokens.push_back({ line.substr(start + 1, i - start - 1), Token::Type::STRING });
+                i++;
+            } else if (c == '[') {
+                // at least one character, each either escaped or neither ] nor a backslash
+                i += i + 1 < line.length() && line[i + 1] == '^' ? 2 : 1;
+                const std::size_t body = i;
+                for (; i < line.length() && line[i] != ']'; i++) {
+                    if (line[i] == '\\' && ++i == line.length()) {
+                        fail(start);
+                    }
+                }
+                if (i == line.length() || i == body) {
+                    fail(start);
+                }
+                i++;
+                tokens.push_back({ line.substr(start, i - start), Token::Type::CLASS });
+            } else if (c == '.') {
+                i++;
+                tokens.push_back({ line.substr(start, 1), Token::Type::CLASS });
+            } else if (c == '@') {
+                i = word(i + 1, start);
+                tokens.push_back({ line.substr(start + 1, i - start - 1), Token::Type::TOKEN });
+            } else if (c == '&' || c == '%' || isWordCharacter(c)) {
+                i = word(isWordCharacter(c) ? i : i + 1, start);
+                tokens.push_back({ line.substr(start, i - start), Token::Type::NONTERMINAL });
             } else {
-                tokens.push_back({ cleanupString(elem), Token::Type::STRING });
+                fail(start);
             }
         }
 
-        if (!containsOnlyWhitespace(cur)) {
-            throw std::runtime_error("Lexer Error at '" + cur + "'.");
+        return tokens;
+    }
+
+    std::string unescape(std::string_view text) {
+        if (text.find('\\') == std::string_view::npos) {
+            return std::string(text);
         }
 
-        return tokens;
+        std::string res;
+        res.reserve(text.length());
+        for (std::size_t i = 0; i < text.length(); i++) {
+            if (text[i] != '\\') {
+                res += text[i];
+                continue;
+            }
+            switch (text[++i]) {
+                case 'n':  res += '\n'; break;
+                case 't':  res += '\t'; break;
+                default:   res += text[i]; break; // \\ \' \"
+            }
+        }
+
+        return res;
     }
 
 } // namespace cfg
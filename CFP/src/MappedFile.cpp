@@ -0,0 +1,42 @@
+#include <fstream>
+#include <iterator>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MappedFile.hpp"
+
+namespace cfg {
+
+    MappedFile::MappedFile(const std::string &filename) : data(MAP_FAILED) {
+        const int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        open = true;
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+            size = info.st_size;
+            data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        if (data == MAP_FAILED) {
+            std::ifstream file(filename, std::ios::binary);
+            buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+        close(fd);
+    }
+
+    MappedFile::~MappedFile() {
+        if (data != MAP_FAILED) {
+            munmap(data, size);
+        }
+    }
+
+    std::string_view MappedFile::contents() const {
+        return data != MAP_FAILED ? std::string_view(static_cast<const char *>(data), size) : std::string_view(buffer);
+    }
+
+} // namespace cfg
@@ -0,0 +1,231 @@
+#include <algorithm>
+
+#include "ParseForest.hpp"
+
+namespace cfg {
+
+    static inline std::uint64_t saturatingAdd(std::uint64_t a, std::uint64_t b) {
+        return a > ParseForest::MANY - b ? ParseForest::MANY : a + b;
+    }
+
+    static inline std::uint64_t saturatingMultiply(std::uint64_t a, std::uint64_t b) {
+        if (a == 0 || b == 0) {
+            return 0;
+        }
+        return a > ParseForest::MANY / b ? ParseForest::MANY : a * b;
+    }
+
+    ParseForest::ParseForest() : root(NONE) {}
+
+    ParseForest::ParseForest(std::shared_ptr<const CompiledGrammar> grammar, std::vector<Node> nodes, unsigned root) :
+        grammar(std::move(grammar)), nodes(std::move(nodes)), root(root) {}
+
+    // Counts on the shared nodes without recursion: every frame of the work stack is a
+    // node whose packed nodes are summed up one at a time, each as the product of the
+    // counts of its two children. <counts> holds the count of every finished node plus
+    // one, 0 if it is unknown; reaching a node on the current path means it lies on a
+    // cycle. A child's count is passed up to its frame in <result>.
+    std::uint64_t ParseForest::countDerivations() const {
+        if (empty()) {
+            return 0;
+        }
+
+        enum class Stage { LEFT, AWAIT_LEFT, AWAIT_RIGHT };
+
+        struct Frame {
+            unsigned node;
+            unsigned alternative;
+            Stage stage;
+            std::uint64_t left, total;
+        };
+
+        std::vector<std::uint64_t> counts(nodes.size(), 0);
+        std::vector<bool> on_path(nodes.size(), false);
+        std::vector<Frame> stack;
+        std::uint64_t result = 0;
+
+        // the count of <node> goes to <result> if it is known right away, otherwise
+        // the node gets a frame of its own
+        auto visit = [&] (unsigned node) {
+            if (counts[node] != 0) {
+                result = counts[node] == MANY ? MANY : counts[node] - 1;
+            } else if (on_path[node]) {
+                result = MANY;
+            } else if (nodes[node].type == NodeType::TERMINAL || nodes[node].type == NodeType::NULLED) {
+                counts[node] = 2;
+                result = 1;
+            } else {
+                on_path[node] = true;
+                stack.push_back({ node, 0, Stage::LEFT, 0, 0 });
+            }
+        };
+
+        visit(root);
+        while (!stack.empty()) {
+            Frame &frame = stack.back();
+            const Node &current = nodes[frame.node];
+
+            switch (frame.stage) {
+                case Stage::LEFT:
+                    if (frame.alternative == current.packed.size()) {
+                        on_path[frame.node] = false;
+                        counts[frame.node] = frame.total == MANY ? MANY : frame.total + 1;
+                        result = frame.total;
+                        stack.pop_back();
+                    } else {
+                        frame.stage = Stage::AWAIT_LEFT;
+                        if (current.packed[frame.alternative].first == NONE) {
+                            result = 1;
+                        } else {
+                            visit(current.packed[frame.alternative].first);
+                        }
+                    }
+                    break;
+                case Stage::AWAIT_LEFT:
+                    frame.left = result;
+                    frame.stage = Stage::AWAIT_RIGHT;
+                    visit(current.packed[frame.alternative].second);
+                    break;
+                case Stage::AWAIT_RIGHT:
+                    frame.total = saturatingAdd(frame.total, saturatingMultiply(frame.left, result));
+                    frame.alternative++;
+                    frame.stage = Stage::LEFT;
+                    break;
+            }
+        }
+
+        return result;
+    }
+
+    ParseForest::TreeIterator::TreeIterator(const ParseForest &forest) :
+        forest(&forest), depth(0), on_path(forest.size(), false), exhausted(forest.empty()) {}
+
+    // the choice at an ambiguous node is read from the odometer, or starts at the
+    // first packed node if the current tree reaches the node for the first time
+    bool ParseForest::TreeIterator::choose(unsigned node, unsigned &chosen) {
+        const std::size_t alternatives = forest->nodes[node].packed.size();
+        if (alternatives == 0) {
+            return false;
+        }
+        if (alternatives == 1) {
+            chosen = 0;
+            return true;
+        }
+
+        if (depth == choices.size()) {
+            choices.emplace_back(0, alternatives);
+        }
+        chosen = choices[depth++].first;
+        return true;
+    }
+
+    // Builds the tree of item <node> into <tree> without recursion: every frame of the
+    // work stack is a tree whose item is walked from the dot to the beginning of its
+    // rule, and a symbol node reached on the way gets a frame for the complete item it
+    // chose on top of the stack, so the choices are made in depth-first order. A
+    // character class of a rule is replaced by the character it matched.
+    bool ParseForest::TreeIterator::buildItem(unsigned node, ProductionTree &tree) {
+        struct Frame {
+            ProductionTree *tree;
+            unsigned item;
+            unsigned symbol; // the symbol node the tree was chosen for, NONE at the top
+        };
+
+        const CompiledGrammar &cg = *forest->grammar;
+
+        std::vector<Frame> stack{ { &tree, node, NONE } };
+        while (!stack.empty()) {
+            Frame &frame = stack.back();
+            ProductionTree &current = *frame.tree;
+
+            if (frame.item == NONE) {
+                std::reverse(current.subtrees.begin(), current.subtrees.end());
+                if (frame.symbol != NONE) {
+                    on_path[frame.symbol] = false;
+                }
+                stack.pop_back();
+                continue;
+            }
+
+            const unsigned item = frame.item;
+            unsigned chosen;
+            if (!choose(item, chosen)) {
+                return false;
+            }
+
+            const std::pair<unsigned, unsigned> packed = forest->nodes[item].packed[chosen];
+            const Node &symbol = forest->nodes[packed.second];
+            frame.item = packed.first;
+
+            switch (symbol.type) {
+                case NodeType::SYMBOL:
+                    {
+                        if (on_path[packed.second] || !choose(packed.second, chosen)) {
+                            return false;
+                        }
+
+                        const unsigned complete = symbol.packed[chosen].second;
+                        const unsigned rule = forest->nodes[complete].id;
+
+                        // the earlier subtrees are finished, so growing them doesn't
+                        // move a tree that is still being built
+                        on_path[packed.second] = true;
+                        current.subtrees.push_back({ cg.getFrom(rule), cg.getRule(rule), std::vector<ProductionTree>{} });
+                        stack.push_back({ &current.subtrees.back(), complete, packed.second });
+                    }
+                    break;
+                case NodeType::NULLED:
+                    current.subtrees.push_back(cg.getNullTree(symbol.id));
+                    break;
+                case NodeType::TERMINAL:
+                    if (current.rule[forest->nodes[item].dot - 1].cls != NO_CLASS) {
+                        current.rule[forest->nodes[item].dot - 1] = { true, { .t = static_cast<Terminal>(symbol.id) } };
+                    }
+                    break;
+                case NodeType::ITEM: // never reached
+                    break;
+            }
+        }
+
+        return true;
+    }
+
+    // advances the odometer: the last ambiguous node that has another packed node
+    // left moves on to it, the choices after it are forgotten
+    bool ParseForest::TreeIterator::step() {
+        while (!choices.empty()) {
+            auto &choice = choices.back();
+            if (choice.first + 1 < choice.second) {
+                choice.first++;
+                return true;
+            }
+            choices.pop_back();
+        }
+
+        exhausted = true;
+        return false;
+    }
+
+    bool ParseForest::TreeIterator::next(ProductionTree &tree) {
+        const CompiledGrammar &cg = *forest->grammar;
+
+        while (!exhausted) {
+            const unsigned rule = forest->nodes[forest->root].id;
+            ProductionTree candidate{ cg.getFrom(rule), cg.getRule(rule), std::vector<ProductionTree>{} };
+
+            depth = 0;
+            std::fill(on_path.begin(), on_path.end(), false);
+            const bool built = buildItem(forest->root, candidate);
+            choices.resize(depth);
+            step();
+
+            if (built) {
+                tree = std::move(candidate);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+} // namespace cfg
@@ -0,0 +1,78 @@
+#include "SyntaxTree.hpp"
+
+namespace cfg {
+
+    SyntaxTree::SyntaxTree() {}
+
+    SyntaxTree::SyntaxTree(std::shared_ptr<const CompiledGrammar> grammar, Text input, std::vector<Node> nodes) :
+        grammar(std::move(grammar)), input(input), nodes(std::move(nodes)) {}
+
+    // Builds the nested tree without recursion. With <refine>, every node is refined as
+    // soon as its subtrees are built, by the flags of its rule, and the nodes of & and %
+    // nonterminals are left without subtrees rather than built.
+    ProductionTree SyntaxTree::toProductionTree(bool refine) const {
+        // a node to build; once built, it comes up again to be refined
+        struct Step {
+            ProductionTree *tree;
+            unsigned node;
+            bool built;
+        };
+
+        ProductionTree result;
+        if (empty()) {
+            return result;
+        }
+
+        const CompiledGrammar &cg = *grammar;
+
+        std::vector<Step> stack{ { &result, 0, false } };
+        while (!stack.empty()) {
+            const Step step = stack.back();
+            stack.pop_back();
+            ProductionTree &tree = *step.tree;
+            const Node &current = nodes[step.node];
+
+            if (step.built) {
+                cg.refineNode(tree, cg.isFullResolve(current.rule));
+                continue;
+            }
+
+            tree.from = cg.getFrom(current.rule);
+            if (refine && step.node != 0 && cg.isCleared(tree.from)) {
+                continue;
+            }
+
+            // a class shows as the character it matched
+            tree.rule = cg.getRule(current.rule);
+            unsigned position = current.begin, children = 0;
+            unsigned subtree = current.first_child;
+            for (Symbol &s : tree.rule) {
+                if (!s.isTerminal) {
+                    position = nodes[subtree].end;
+                    subtree = nodes[subtree].next_sibling;
+                    children++;
+                    continue;
+                }
+                const unsigned length = cg.getLength(s);
+                if (s.cls != NO_CLASS) {
+                    s = { true, { .t = input[position] } };
+                }
+                position += length;
+            }
+
+            if (refine) {
+                stack.push_back({ step.tree, step.node, true });
+            }
+
+            // the subtrees are not resized again, so the pointers stay valid
+            tree.subtrees.resize(children);
+            unsigned i = 0;
+            for (unsigned child = current.first_child; child != NONE; child = nodes[child].next_sibling) {
+                stack.push_back({ &tree.subtrees[i++], child, false });
+            }
+        }
+
+        return result;
+    }
+
+} // namespace cfg
@@ -0,0 +1,46 @@
+#include <algorithm>
+
+#include "Trace.hpp"
+
+namespace cfg {
+
+    StreamTraceSink::StreamTraceSink(std::ostream &stream, unsigned levels) : stream(stream), levels(levels) {}
+
+    bool StreamTraceSink::enabled(TraceLevel level) const {
+        return levels & static_cast<unsigned>(level);
+    }
+
+    void StreamTraceSink::write(TraceLevel level, const std::string &message) {
+        std::lock_guard<std::mutex> lock(mutex);
+        stream << message << '\n';
+    }
+
+    RingBufferTraceSink::RingBufferTraceSink(std::size_t capacity, unsigned levels) :
+            buffer(capacity), next(0), count(0), levels(levels) {}
+
+    bool RingBufferTraceSink::enabled(TraceLevel level) const {
+        return levels & static_cast<unsigned>(level);
+    }
+
+    void RingBufferTraceSink::write(TraceLevel level, const std::string &message) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (buffer.empty()) {
+            return;
+        }
+
+        buffer.at(next) = message;
+        next = (next + 1) % buffer.size();
+        count = std::min(count + 1, buffer.size());
+    }
+
+    std::vector<std::string> RingBufferTraceSink::messages() const {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        std::vector<std::string> res;
+        for (std::size_t i = 0; i < count; i++) {
+            res.push_back(buffer.at((next + buffer.size() - count + i) % buffer.size()));
+        }
+        return res;
+    }
+
+} // namespace cfg
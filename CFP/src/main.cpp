@@ -1,10 +1,17 @@
+#include <algorithm>
 #include <chrono>
 #include <cstdlib>
 #include <iostream>
+#include <optional>
+#include <sstream>
+#include <thread>
 
+#include "BatchParser.hpp"
 #include "CYKParser.hpp"
 #include "EarleyParser.hpp"
 #include "Grammar.hpp"
+#include "GrammarImage.hpp"
+#include "Trace.hpp"
 
 using namespace cfg;
 
@@ -14,9 +21,40 @@ int main(int argc, char **argv) {
 
     if (argc <= 2) {
         std::cout << "Enter the desired parsing schema first (-cyk or -earley), followed by the grammar file.\n";
+        std::cout << "Add -trace to print the grammar, parse tables and trees, or -trace=<levels> to select\n";
+        std::cout << "from grammar, table, tree and steps (comma-separated). With -stream, the Earley parser\n";
+        std::cout << "reads all of the standard input as one input and stops at its first invalid chunk.\n";
+        std::cout << "With -batch or -batch=<threads>, every line up to the end of the input is parsed, on\n";
+        std::cout << "as many threads as there are cores by default, and the results follow in input order.\n";
+        std::cout << "-compile <grammar> <image> compiles a grammar ahead of time into a binary image, which\n";
+        std::cout << "both parsers load in place of the grammar file without parsing it again. With\n";
+        std::cout << "-compile=cyk, the image also holds the grammar in CNF for the CYK parser, which\n";
+        std::cout << "otherwise converts it on load.\n";
+        std::cout << "With -tree=<format>, the Earley parser writes the tree of every line it accepts to the\n";
+        std::cout << "standard output, as text, json, sexpr (S-expressions) or binary (LEB128 varints).\n";
         return 1;
     }
 
+    if (argv[1] == std::string("-compile") || argv[1] == std::string("-compile=cyk")) {
+        if (argc != 4) {
+            std::cout << "Enter the grammar file and the image to write after -compile.\n";
+            return 2;
+        }
+        try {
+            GrammarManager gm;
+            gm.parseFromFile(argv[2]);
+            if (gm.getGrammar().empty()) {
+                std::cout << "Grammar Parse Error: No rules in '" << argv[2] << "'.\n";
+                return 1;
+            }
+            GrammarImage::write(gm, argv[3], argv[1] == std::string("-compile=cyk"));
+        } catch (std::runtime_error &e) {
+            std::cout << "Grammar Parse Error: " << e.what() << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
     Parser *parser = nullptr;
 
     if (argv[1] == std::string("-cyk")) {
@@ -28,6 +66,86 @@ int main(int argc, char **argv) {
         return 2;
     }
 
+    unsigned trace_levels = 0;
+    bool stream = false;
+    unsigned batch = 0;
+    std::optional<TreeFormat> tree_format;
+    for (int arg = 3; arg < argc; arg++) {
+        if (argv[arg] == std::string("-stream")) {
+            stream = true;
+        } else if (argv[arg] == std::string("-batch")) {
+            batch = std::max(1u, std::thread::hardware_concurrency());
+        } else if (std::string(argv[arg]).rfind("-batch=", 0) == 0) {
+            const std::string threads = std::string(argv[arg]).substr(7);
+            if (threads.empty() || threads.find_first_not_of("0123456789") != std::string::npos || std::stoul(threads) == 0) {
+                std::cout << "Invalid Thread Count '" << threads << "'.\n";
+                return 2;
+            }
+            batch = std::stoul(threads);
+        } else if (std::string(argv[arg]).rfind("-tree=", 0) == 0) {
+            const std::string format = std::string(argv[arg]).substr(6);
+            if (format == "text") {
+                tree_format = TreeFormat::TEXT;
+            } else if (format == "json") {
+                tree_format = TreeFormat::JSON;
+            } else if (format == "sexpr") {
+                tree_format = TreeFormat::SEXPRESSION;
+            } else if (format == "binary") {
+                tree_format = TreeFormat::BINARY;
+            } else {
+                std::cout << "Invalid Tree Format '" << format << "'.\n";
+                return 2;
+            }
+        } else if (argv[arg] == std::string("-trace")) {
+            trace_levels = TraceLevel::GRAMMAR | TraceLevel::TABLE | TraceLevel::TREE;
+        } else if (std::string(argv[arg]).rfind("-trace=", 0) == 0) {
+            std::stringstream levels(std::string(argv[arg]).substr(7));
+            std::string level;
+            while (std::getline(levels, level, ',')) {
+                if (level == "grammar") {
+                    trace_levels = trace_levels | TraceLevel::GRAMMAR;
+                } else if (level == "table") {
+                    trace_levels = trace_levels | TraceLevel::TABLE;
+                } else if (level == "tree") {
+                    trace_levels = trace_levels | TraceLevel::TREE;
+                } else if (level == "steps") {
+                    trace_levels = trace_levels | TraceLevel::STEP;
+                } else {
+                    std::cout << "Invalid Trace Level '" << level << "'.\n";
+                    return 2;
+                }
+            }
+        } else {
+            std::cout << "Invalid Option '" << argv[arg] << "'.\n";
+            return 2;
+        }
+    }
+
+    if (stream && !dynamic_cast<EarleyParser *>(parser)) {
+        std::cout << "Streaming is only supported by the Earley parser.\n";
+        return 2;
+    }
+
+    if (tree_format && !dynamic_cast<EarleyParser *>(parser)) {
+        std::cout << "Writing trees is only supported by the Earley parser.\n";
+        return 2;
+    }
+
+    if (tree_format && (stream || batch)) {
+        std::cout << "Trees are only written for inputs parsed one line at a time.\n";
+        return 2;
+    }
+
+    if (stream && batch) {
+        std::cout << "Streaming and batch mode exclude each other.\n";
+        return 2;
+    }
+
+    StreamTraceSink trace(std::cout, trace_levels);
+    if (trace_levels) {
+        parser->setTraceSink(&trace);
+    }
+
     try {
         parser->initGrammar(argv[2]);
     } catch (std::runtime_error &e) {
@@ -35,10 +153,71 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    // the whole standard input is a single input, fed in chunks as it arrives; without
+    // a table or tree to trace, it is only recognized, in memory bounded by its nesting
+    if (stream) {
+        EarleyParser *earley = static_cast<EarleyParser *>(parser);
+        const bool tree = trace_levels & (TraceLevel::TABLE | TraceLevel::TREE | TraceLevel::STEP);
+
+        EarleyParser::Session session = earley->startSession();
+        EarleyParser::Recognizer recognizer = earley->startRecognizer();
+
+        std::vector<char> buffer(1 << 16);
+        std::size_t offset = 0;
+        while (std::cin.read(buffer.data(), buffer.size()) || std::cin.gcount() > 0) {
+            const std::size_t count = std::cin.gcount();
+            const String chunk = toTerminals(std::string(buffer.data(), count));
+            if (!(tree ? session.feed(chunk) : recognizer.feed(chunk))) {
+                std::cout << "Parse unsuccessful (rejected within the first " << offset + count << " bytes)\n";
+                return 0;
+            }
+            offset += count;
+        }
+
+        const bool success = tree ? session.finish().first : recognizer.finish();
+        std::cout << "Parse " << (success ? "" : "un") << "successful\n";
+        return 0;
+    }
+
+    // every line is an input of its own; the lines are read in blocks, so that reading
+    // the next block waits for the threads only once per block
+    if (batch) {
+        constexpr std::size_t BLOCK = 1 << 16;
+        std::vector<String> inputs;
+        std::string line;
+        bool more = true;
+        while (more) {
+            inputs.clear();
+            while (inputs.size() < BLOCK && (more = bool(std::getline(std::cin, line)))) {
+                inputs.push_back(toTerminals(line));
+            }
+            for (bool success : parseBatch(*parser, inputs, batch)) {
+                std::cout << "Parse " << (success ? "" : "un") << "successful\n";
+            }
+        }
+        return 0;
+    }
+
+    ParseWorkspace workspace;
     std::string line;
     do {
         std::getline(std::cin, line);
-        std::cout << "Parse " << (parser->parseInput(toTerminals(line)) ? "" : "un") << "successful\n";
+        bool success;
+        if (tree_format) {
+            const EarleyParser *earley = static_cast<EarleyParser *>(parser);
+            const auto [accepted, tree] = earley->parseTree(toTerminals(line));
+            if (accepted) {
+                // the text listing ends in a line break and a binary tree delimits itself
+                earley->writeTree(std::cout, tree, *tree_format);
+                if (*tree_format == TreeFormat::JSON || *tree_format == TreeFormat::SEXPRESSION) {
+                    std::cout << '\n';
+                }
+            }
+            success = accepted;
+        } else {
+            success = parser->parseInput(toTerminals(line), workspace);
+        }
+        std::cout << "Parse " << (success ? "" : "un") << "successful\n";
     } while (!line.empty());
 
     return 0;
@@ -52,12 +52,31 @@ namespace cfg {
         g[S] = {{{{ false, { .n = index } }}}};
     }
 
+    // spell every literal out into its terminals, a rule of CNF only reads one of them
+    static void expandLiterals(Grammar &g, const std::vector<String> &literals) {
+        for (auto &it : g) {
+            for (Rule &r : it.second) {
+                Rule expanded;
+                for (const Symbol &s : r) {
+                    if (s.isTerminal && s.literal != NO_LITERAL) {
+                        for (Terminal t : literals.at(s.literal)) {
+                            expanded.push_back({ true, { .t = t } });
+                        }
+                    } else {
+                        expanded.push_back(s);
+                    }
+                }
+                r = std::move(expanded);
+            }
+        }
+    }
+
     // replace all nonterminals 'a' with new nonterminals A with single rule A -> 'a'
     // this step isn't done for production rules of length 1 since these already 
     //   correspond to rules in CNF
     // Contract Assumption: index >= max { nonterminals }
     static void replaceTerminals(Grammar &g, Nonterminal &index) {
-        std::map<Terminal, Nonterminal> newrule_mapping;
+        std::map<std::pair<Terminal, unsigned>, Nonterminal> newrule_mapping; // (terminal, class)
 
         // replace terminals with new pseudo-rules
         for (auto &it : g) {
@@ -67,12 +86,14 @@ namespace cfg {
                 }
                 for (Symbol &s : r) {
                     if (s.isTerminal) {
-                        if (newrule_mapping.find(s.t) == newrule_mapping.end()) {
-                            newrule_mapping[s.t] = ++index;
+                        const std::pair<Terminal, unsigned> terminal = { s.t, s.cls };
+                        if (newrule_mapping.find(terminal) == newrule_mapping.end()) {
+                            newrule_mapping[terminal] = ++index;
                         }
 
                         s.isTerminal = false;
-                        s.n = newrule_mapping[s.t];
+                        s.n = newrule_mapping[terminal];
+                        s.cls = NO_CLASS;
                     }
                 }
             }
@@ -80,7 +101,7 @@ namespace cfg {
 
         // create actual productions from pseudo-rules
         for (const auto &it : newrule_mapping) {
-            g[it.second].push_back({{{ true, { .t = it.first } }}});
+            g[it.second].push_back({{{ true, { .t = it.first.first }, it.first.second }}});
         }
     }
 
@@ -256,6 +277,7 @@ namespace cfg {
 
         Nonterminal nonterminal_index = findMaxIndex(g) + 1;
 
+        expandLiterals(g, literals);
         replaceStart(g, nonterminal_index);
         replaceTerminals(g, nonterminal_index);
         refineRHS(g, nonterminal_index);
@@ -263,7 +285,11 @@ namespace cfg {
         eliminateUnitRules(g);
 
         GrammarManager res(g);
-        res.nonterminal_maxindex = nonterminal_index;
+        res.classes = classes;
+        res.token_index_map = token_index_map;
+        res.token_names = token_names;
+        res.token_maxindex = token_maxindex;
+        res.nonterminal_maxindex = nonterminal_index + 1; // the passes leave the last index they took
         res.fullresolveRules = {};
         return res;
     }
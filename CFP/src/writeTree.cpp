@@ -0,0 +1,321 @@
+#include <cstdint>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Grammar.hpp"
+
+namespace cfg {
+
+    // writes to the buffer of a stream directly, without the sentry every << sets up
+    class TreeOutput {
+
+    private:
+
+        std::streambuf &buffer;
+
+    public:
+
+        TreeOutput(std::ostream &out) : buffer(*out.rdbuf()) {}
+
+        inline void put(char c) { buffer.sputc(c); }
+        inline void put(std::string_view text) { buffer.sputn(text.data(), text.length()); }
+
+        inline void number(std::uint64_t n) {
+            char digits[20];
+            unsigned length = 0;
+            do {
+                digits[length++] = '0' + n % 10;
+                n /= 10;
+            } while (n > 0);
+            while (length > 0) {
+                put(digits[--length]);
+            }
+        }
+
+        inline void varint(std::uint64_t n) {
+            while (n >= 0x80) {
+                put(static_cast<char>((n & 0x7f) | 0x80));
+                n >>= 7;
+            }
+            put(static_cast<char>(n));
+        }
+
+        // <text> between double quotes, escaped for JSON if <json> and else only as far
+        // as quotes, backslashes, line breaks and tabs go
+        inline void quoted(std::string_view text, bool json) {
+            static constexpr char HEX[] = "0123456789abcdef";
+
+            put('"');
+            for (const char c : text) {
+                switch (c) {
+                    case '"':  put("\\\""); break;
+                    case '\\': put("\\\\"); break;
+                    case '\n': put("\\n"); break;
+                    case '\t': put("\\t"); break;
+                    default:
+                        if (json && static_cast<unsigned char>(c) < 0x20) {
+                            put("\\u00");
+                            put(HEX[static_cast<unsigned char>(c) >> 4]);
+                            put(HEX[c & 0xf]);
+                        } else {
+                            put(c);
+                        }
+                }
+            }
+            put('"');
+        }
+    };
+
+    // Visits the nodes of <root> in preorder with an explicit stack, so that deep trees
+    // don't run out of call stack: enter(tree, depth) on every node, terminal(symbol,
+    // depth) and missing(depth) on the terminals and missing subtrees of the node at
+    // <depth>, and leave(tree, depth) once all of its symbols are done. <first> tells
+    // whether a node or terminal is the first symbol of its parent.
+    template<typename Visitor>
+    static void walkTree(const ProductionTree &root, Visitor &visitor) {
+        struct Frame {
+            const ProductionTree *tree;
+            unsigned symbol, subtree;
+        };
+
+        std::vector<Frame> stack{ { &root, 0, 0 } };
+        visitor.enter(root, 0, true);
+
+        while (!stack.empty()) {
+            Frame &frame = stack.back();
+            const unsigned depth = stack.size() - 1;
+            const ProductionTree &tree = *frame.tree;
+
+            if (frame.symbol == tree.rule.size()) {
+                visitor.leave(tree, depth);
+                stack.pop_back();
+                continue;
+            }
+
+            const bool first = frame.symbol == 0;
+            const Symbol &s = tree.rule[frame.symbol++];
+            if (s.isTerminal) {
+                visitor.terminal(s, depth, first);
+            } else if (frame.subtree < tree.subtrees.size()) {
+                const ProductionTree &child = tree.subtrees[frame.subtree++];
+                visitor.enter(child, depth + 1, first);
+                stack.push_back({ &child, 0, 0 });
+            } else {
+                visitor.missing(depth, first);
+            }
+        }
+    }
+
+    void GrammarManager::writeTree(std::ostream &out, const ProductionTree &tree, TreeFormat format) const {
+
+        // what the writers of all formats share
+        struct Writer {
+            const GrammarManager &gm;
+            TreeOutput output;
+            std::string text;
+
+            void nonterminal(Nonterminal n) {
+                if (n < gm.nonterminal_names.size() && !gm.nonterminal_names[n].empty()) {
+                    output.put(gm.nonterminal_names[n]);
+                } else {
+                    output.number(n);
+                }
+            }
+
+            bool isToken(const Symbol &s) const {
+                return s.cls == NO_CLASS && s.literal == NO_LITERAL && s.t >= CHARACTERS;
+            }
+
+            // the name of a token, or its id if the grammar has no name for it
+            void token(const Symbol &s) {
+                if (s.t - CHARACTERS < gm.token_names.size() && !gm.token_names[s.t - CHARACTERS].empty()) {
+                    output.put(gm.token_names[s.t - CHARACTERS]);
+                } else {
+                    output.number(s.t);
+                }
+            }
+
+            // the text a terminal symbol other than a token stands for: its character or
+            // literal, or for a class that is still a class, the class
+            std::string_view terminalText(const Symbol &s) {
+                if (s.cls != NO_CLASS) {
+                    text = classToString(gm.classes.at(s.cls));
+                } else if (s.literal != NO_LITERAL) {
+                    text.assign(gm.literals.at(s.literal).begin(), gm.literals.at(s.literal).end());
+                } else {
+                    text.assign(1, static_cast<char>(s.t));
+                }
+                return text;
+            }
+
+            // the terminal the way getTerminalName() writes it
+            void terminalName(const Symbol &s) {
+                if (isToken(s)) {
+                    output.put('@');
+                    token(s);
+                } else {
+                    output.put(terminalText(s));
+                }
+            }
+        };
+
+        // the rule of every node in one line, followed by its terminals and subtrees
+        struct TextWriter : Writer {
+            void indent(unsigned depth) {
+                for (unsigned i = 0; i < depth; i++) {
+                    output.put("    ");
+                }
+            }
+
+            void enter(const ProductionTree &tree, unsigned depth, bool) {
+                indent(depth);
+                nonterminal(tree.from);
+                output.put(" -> ");
+                if (tree.rule.empty()) {
+                    output.put("€");
+                } else {
+                    output.put('\'');
+                    for (const Symbol &s : tree.rule) {
+                        if (s.isTerminal) {
+                            output.put("\033[31m");
+                            terminalName(s);
+                            output.put("\033[0m");
+                        } else {
+                            output.put('<');
+                            nonterminal(s.n);
+                            output.put('>');
+                        }
+                    }
+                    output.put('\'');
+                }
+                output.put(":\n");
+            }
+
+            void terminal(const Symbol &s, unsigned depth, bool) {
+                indent(depth);
+                terminalName(s);
+                output.put('\n');
+            }
+
+            void missing(unsigned depth, bool) {
+                indent(depth + 1);
+                output.put("<missing tree!!>\n");
+            }
+
+            void leave(const ProductionTree &, unsigned) {}
+        };
+
+        struct JSONWriter : Writer {
+            void enter(const ProductionTree &tree, unsigned, bool first) {
+                if (!first) {
+                    output.put(',');
+                }
+                output.put("{\"nonterminal\":\"");
+                nonterminal(tree.from);
+                output.put("\",\"children\":[");
+            }
+
+            void terminal(const Symbol &s, unsigned, bool first) {
+                if (!first) {
+                    output.put(',');
+                }
+                if (isToken(s)) {
+                    output.put("{\"token\":\"");
+                    token(s);
+                    output.put("\"}");
+                } else {
+                    output.quoted(terminalText(s), true);
+                }
+            }
+
+            void missing(unsigned, bool first) {
+                output.put(first ? "null" : ",null");
+            }
+
+            void leave(const ProductionTree &, unsigned) {
+                output.put("]}");
+            }
+        };
+
+        struct SExpressionWriter : Writer {
+            void enter(const ProductionTree &tree, unsigned depth, bool) {
+                output.put(depth > 0 ? " (" : "(");
+                nonterminal(tree.from);
+            }
+
+            void terminal(const Symbol &s, unsigned, bool) {
+                output.put(' ');
+                if (isToken(s)) {
+                    output.put('@');
+                    token(s);
+                } else {
+                    output.quoted(terminalText(s), false);
+                }
+            }
+
+            void missing(unsigned, bool) {
+                output.put(" ()");
+            }
+
+            void leave(const ProductionTree &, unsigned) {
+                output.put(')');
+            }
+        };
+
+        struct BinaryWriter : Writer {
+            void enter(const ProductionTree &tree, unsigned, bool) {
+                std::uint64_t children = 0;
+                for (const Symbol &s : tree.rule) {
+                    children += s.isTerminal && s.literal != NO_LITERAL ? gm.literals.at(s.literal).size() : 1;
+                }
+                output.varint(std::uint64_t{ tree.from } << 1);
+                output.varint(children);
+            }
+
+            void terminal(const Symbol &s, unsigned, bool) {
+                if (s.literal == NO_LITERAL) {
+                    output.varint(std::uint64_t{ s.t } << 1 | 1);
+                    return;
+                }
+                for (Terminal t : gm.literals.at(s.literal)) {
+                    output.varint(std::uint64_t{ t } << 1 | 1);
+                }
+            }
+
+            void missing(unsigned, bool) {
+                output.varint(std::uint64_t{ FAIL } << 1);
+                output.varint(0);
+            }
+
+            void leave(const ProductionTree &, unsigned) {}
+        };
+
+        const Writer writer{ *this, TreeOutput(out), "" };
+        switch (format) {
+            case TreeFormat::TEXT: {
+                TextWriter visitor{ writer };
+                walkTree(tree, visitor);
+                break;
+            }
+            case TreeFormat::JSON: {
+                JSONWriter visitor{ writer };
+                walkTree(tree, visitor);
+                break;
+            }
+            case TreeFormat::SEXPRESSION: {
+                SExpressionWriter visitor{ writer };
+                walkTree(tree, visitor);
+                break;
+            }
+            case TreeFormat::BINARY: {
+                BinaryWriter visitor{ writer };
+                walkTree(tree, visitor);
+                break;
+            }
+        }
+    }
+
+} // namespace cfg